@@ -0,0 +1,347 @@
+#include <dirent.h>
+#include <mpi.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+#include "affinity.h"
+#include "utils.h"
+
+const int Placement::MAIN_THREAD;
+const int Placement::COMPUTE_THREAD;
+const int Placement::FIRST_IO_THREAD;
+
+const std::string SYSFS_CPU_DIR = "/sys/devices/system/cpu";
+const std::string SYSFS_NODE_DIR = "/sys/devices/system/node";
+
+bool readSysfsLine(const std::string& path, std::string& line) {
+    std::ifstream file(path);
+    return file && std::getline(file, line);
+}
+
+int readSysfsInt(const std::string& path, int defaultValue) {
+    std::string line;
+    return readSysfsLine(path, line) ? std::atoi(line.c_str()) : defaultValue;
+}
+
+// Parses list of hardware threads in /sys format, e.g. "0-3,8-11"
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Formats list of hardware threads in /sys format
+std::string formatCpuList(std::vector<int> cpus) {
+    std::sort(cpus.begin(), cpus.end());
+    std::stringstream ss;
+    for (int i = 0; i < (int)cpus.size(); i++) {
+        int first = cpus[i];
+        while (i + 1 < (int)cpus.size() && cpus[i + 1] == cpus[i] + 1) {
+            i++;
+        }
+        ss << (first == cpus[0] ? "" : ",") << first;
+        if (cpus[i] != first) {
+            ss << "-" << cpus[i];
+        }
+    }
+    return ss.str();
+}
+
+std::vector<int> cpuSetToList(const cpu_set_t& set) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+CpuTopology CpuTopology::fromSysfs(const cpu_set_t& allowed) {
+    std::string online;
+    std::vector<int> cpuIds = readSysfsLine(SYSFS_CPU_DIR + "/online", online) ? parseCpuList(online)
+                                                                               : cpuSetToList(allowed);
+
+    std::map<int, int> numaNodeOfCpu;
+    std::set<int> numaNodes;
+    if (DIR* nodeDir = opendir(SYSFS_NODE_DIR.c_str())) {
+        while (dirent* entry = readdir(nodeDir)) {
+            int node;
+            std::string cpuList;
+            if (std::sscanf(entry->d_name, "node%d", &node) == 1 &&
+                readSysfsLine(SYSFS_NODE_DIR + "/" + entry->d_name + "/cpulist", cpuList)) {
+                for (int cpu : parseCpuList(cpuList)) {
+                    numaNodeOfCpu[cpu] = node;
+                }
+            }
+        }
+        closedir(nodeDir);
+    }
+
+    // (NUMA node, L3 domain, package, core id) of each allowed hardware thread
+    std::map<std::tuple<int, int, int, int>, std::vector<int>> coreThreads;
+    std::map<int, std::tuple<int, int>> location;
+    std::set<int> l3Domains;
+    for (int id : cpuIds) {
+        if (id >= CPU_SETSIZE || !CPU_ISSET(id, &allowed)) {
+            continue;
+        }
+        std::string cpuDir = SYSFS_CPU_DIR + "/cpu" + std::to_string(id);
+        int package = readSysfsInt(cpuDir + "/topology/physical_package_id", 0);
+        int coreId = readSysfsInt(cpuDir + "/topology/core_id", id);
+
+        int l3Domain = 0;
+        for (int index = 0;; index++) {
+            std::string indexDir = cpuDir + "/cache/index" + std::to_string(index);
+            int level = readSysfsInt(indexDir + "/level", -1);
+            std::string sharedCpus;
+            if (level < 0) {
+                break;
+            } else if (level == 3 && readSysfsLine(indexDir + "/shared_cpu_list", sharedCpus)) {
+                std::vector<int> shared = parseCpuList(sharedCpus);
+                l3Domain = shared.empty() ? 0 : *std::min_element(shared.begin(), shared.end());
+            }
+        }
+
+        int numaNode = numaNodeOfCpu.count(id) ? numaNodeOfCpu[id] : 0;
+        coreThreads[std::make_tuple(numaNode, l3Domain, package, coreId)].push_back(id);
+        location[id] = std::make_tuple(numaNode, l3Domain);
+        numaNodes.insert(numaNode);
+        l3Domains.insert(l3Domain);
+    }
+
+    CpuTopology topology;
+    for (auto& core : coreThreads) {
+        std::sort(core.second.begin(), core.second.end());
+        for (int id : core.second) {
+            topology.cpus.push_back(
+                {id, (int)topology.cores.size(), std::get<0>(location[id]), std::get<1>(location[id])});
+        }
+        topology.cores.push_back(core.second);
+    }
+    topology.numNumaNodes = std::max(1, (int)numaNodes.size());
+    topology.numL3Domains = std::max(1, (int)l3Domains.size());
+    return topology;
+}
+
+const CpuTopology::Cpu& CpuTopology::cpu(int id) const {
+    for (const Cpu& cpu : this->cpus) {
+        if (cpu.id == id) {
+            return cpu;
+        }
+    }
+    throw "Hardware thread is not part of the topology";
+}
+
+/*
+    Launcher's bindings are compared only between processes, which were actually bound (i.e. not allowed
+    to run on every hardware thread available to the job on the node).
+*/
+std::vector<std::string> detectPinningMistakes(const CpuTopology& topology, const std::vector<cpu_set_t>& bindings,
+                                               const std::vector<int>& processIds) {
+    std::vector<std::string> warnings;
+    int numProcesses = bindings.size();
+    int numCores = topology.cores.size();
+
+    if (numProcesses > numCores) {
+        std::stringstream ss;
+        ss << numProcesses << " processes share " << numCores << " physical cores, the node is oversubscribed";
+        warnings.push_back(ss.str());
+    }
+
+    std::vector<bool> bound(numProcesses);
+    std::vector<std::set<int>> boundCores(numProcesses), boundNumaNodes(numProcesses);
+    for (int p = 0; p < numProcesses; p++) {
+        bound[p] = CPU_COUNT(&bindings[p]) < (int)topology.cpus.size();
+        for (const CpuTopology::Cpu& cpu : topology.cpus) {
+            if (CPU_ISSET(cpu.id, &bindings[p])) {
+                boundCores[p].insert(cpu.core);
+                boundNumaNodes[p].insert(cpu.numaNode);
+            }
+        }
+        if (bound[p] && boundNumaNodes[p].size() > 1) {
+            std::stringstream ss;
+            ss << "process " << processIds[p] << " is bound across " << boundNumaNodes[p].size() << " NUMA nodes";
+            warnings.push_back(ss.str());
+        }
+    }
+
+    for (int p = 0; p < numProcesses; p++) {
+        for (int r = p + 1; r < numProcesses; r++) {
+            if (!bound[p] || !bound[r]) {
+                continue;
+            }
+            cpu_set_t common;
+            CPU_AND(&common, &bindings[p], &bindings[r]);
+            std::stringstream ss;
+            if (CPU_COUNT(&common) > 0) {
+                ss << "processes " << processIds[p] << " and " << processIds[r]
+                   << " are bound to overlapping hardware threads " << formatCpuList(cpuSetToList(common));
+                warnings.push_back(ss.str());
+            } else if (boundCores[p].size() == 1 && boundCores[p] == boundCores[r] && numProcesses <= numCores) {
+                ss << "processes " << processIds[p] << " and " << processIds[r]
+                   << " are bound to SMT siblings of the same core, while other cores are left idle";
+                warnings.push_back(ss.str());
+            }
+        }
+    }
+    return warnings;
+}
+
+Placement Placement::ofProcess(int processId, int denseGroupId, bool pin) {
+    cpu_set_t launcherBinding;
+    CPU_ZERO(&launcherBinding);
+    sched_getaffinity(0, sizeof(launcherBinding), &launcherBinding);
+
+    MPI_Comm nodeComm;
+    Placement placement;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, processId, MPI_INFO_NULL, &nodeComm);
+    MPI_Comm_rank(nodeComm, &placement.nodeProcessId);
+    MPI_Comm_size(nodeComm, &placement.numNodeProcesses);
+
+    std::vector<cpu_set_t> bindings(placement.numNodeProcesses);
+    MPI_Allgather(&launcherBinding, sizeof(cpu_set_t), MPI_BYTE, bindings.data(), sizeof(cpu_set_t), MPI_BYTE,
+                  nodeComm);
+    int key[2] = {denseGroupId, processId};
+    std::vector<int> keys(2 * placement.numNodeProcesses);
+    MPI_Allgather(key, 2, MPI_INT, keys.data(), 2, MPI_INT, nodeComm);
+    MPI_Comm_free(&nodeComm);
+
+    // hardware threads available to the job on the node
+    cpu_set_t available;
+    CPU_ZERO(&available);
+    std::vector<int> processIds;
+    std::vector<std::pair<int, int>> order;
+    for (int p = 0; p < placement.numNodeProcesses; p++) {
+        CPU_OR(&available, &available, &bindings[p]);
+        processIds.push_back(keys[2 * p + 1]);
+        order.push_back(std::make_pair(keys[2 * p], keys[2 * p + 1]));
+    }
+    std::sort(order.begin(), order.end());
+    int position = std::find(order.begin(), order.end(), std::make_pair(denseGroupId, processId)) - order.begin();
+
+    CpuTopology topology = CpuTopology::fromSysfs(available);
+    placement.warnings = detectPinningMistakes(topology, bindings, processIds);
+    placement.launcherCpus = formatCpuList(cpuSetToList(launcherBinding));
+
+    int numCores = topology.cores.size();
+    int numProcesses = placement.numNodeProcesses;
+    if (pin && numCores > 0) {
+        placement.pinned = true;
+        int maxSiblings = 0;
+        for (auto& core : topology.cores) {
+            maxSiblings = std::max(maxSiblings, (int)core.size());
+        }
+
+        // with more processes than cores, each gets a single hardware thread, filling physical cores first
+        int firstCore = 0, lastCore = numCores;
+        if (numProcesses <= numCores) {
+            firstCore = utils::getFairPartBeginning(position, numCores, numProcesses);
+            lastCore = utils::getFairPartBeginning(position + 1, numCores, numProcesses);
+        }
+        std::vector<int> cpus;
+        for (int sibling = 0; sibling < maxSiblings; sibling++) {
+            for (int c = firstCore; c < lastCore; c++) {
+                if (sibling < (int)topology.cores[c].size()) {
+                    cpus.push_back(topology.cores[c][sibling]);
+                }
+            }
+        }
+        placement.cpus = numProcesses <= numCores ? cpus : std::vector<int>{cpus[position % cpus.size()]};
+
+        int numSingleCpu = 0;
+        for (int p = 0; p < numProcesses; p++) {
+            int first = utils::getFairPartBeginning(p, numCores, numProcesses);
+            int last = utils::getFairPartBeginning(p + 1, numCores, numProcesses);
+            numSingleCpu += numProcesses > numCores || (last - first == 1 && topology.cores[first].size() == 1);
+        }
+        if (numSingleCpu > 0) {
+            std::stringstream ss;
+            ss << numSingleCpu << " processes are pinned to a single hardware thread, their helper threads are "
+               << "left unpinned to not preempt the main thread";
+            placement.warnings.push_back(ss.str());
+        }
+    }
+
+    std::stringstream ss;
+    char hostName[MPI_MAX_PROCESSOR_NAME];
+    int hostNameLength;
+    MPI_Get_processor_name(hostName, &hostNameLength);
+    ss << "process " << processId << " on " << hostName << ": ";
+    if (placement.pinned) {
+        std::set<int> cores, numaNodes, l3Domains;
+        for (int id : placement.cpus) {
+            cores.insert(topology.cpu(id).core);
+            numaNodes.insert(topology.cpu(id).numaNode);
+            l3Domains.insert(topology.cpu(id).l3Domain);
+        }
+        ss << "cpus " << formatCpuList(placement.cpus) << " (main thread "
+           << placement.cpuOfThread(MAIN_THREAD) << ", cores " << formatCpuList({cores.begin(), cores.end()})
+           << ", numa " << formatCpuList({numaNodes.begin(), numaNodes.end()}) << ", l3 "
+           << formatCpuList({l3Domains.begin(), l3Domains.end()}) << ")";
+    } else {
+        ss << "not pinned";
+    }
+    ss << ", launcher cpus " << placement.launcherCpus;
+    placement.description = ss.str();
+
+    return placement;
+}
+
+void Placement::pinThread(int thread) const {
+    if (!this->pinned || (thread != MAIN_THREAD && this->cpus.size() == 1)) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(this->cpuOfThread(thread), &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        throw "Cannot set affinity of thread";
+    }
+}
+
+std::vector<std::string> Placement::gatherDescriptions(int root) const {
+    int processId, numProcesses;
+    MPI_Comm_rank(MPI_COMM_WORLD, &processId);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcesses);
+
+    int length = this->description.size();
+    std::vector<int> lengths(numProcesses), displacements(numProcesses);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, root, MPI_COMM_WORLD);
+
+    int totalLength = 0;
+    for (int p = 0; p < numProcesses; p++) {
+        displacements[p] = totalLength;
+        totalLength += lengths[p];
+    }
+    std::string gathered(totalLength, '\0');
+    MPI_Gatherv(this->description.data(), length, MPI_CHAR, &gathered[0], lengths.data(), displacements.data(),
+                MPI_CHAR, root, MPI_COMM_WORLD);
+
+    std::vector<std::string> descriptions;
+    if (processId == root) {
+        for (int p = 0; p < numProcesses; p++) {
+            descriptions.push_back(gathered.substr(displacements[p], lengths[p]));
+        }
+    }
+    return descriptions;
+}
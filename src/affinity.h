@@ -0,0 +1,79 @@
+#ifndef __AFFINITY_H__
+#define __AFFINITY_H__
+
+#include <mpi.h>
+#include <sched.h>
+
+#include <string>
+#include <vector>
+
+/*
+    Hardware threads of the node, as described by /sys. Missing entries (e.g. no NUMA support) fall back
+    to a single NUMA node and L3 domain, and to each hardware thread being a separate core.
+*/
+class CpuTopology {
+public:
+    struct Cpu {
+        int id;
+        int core;      // index of physical core within the node
+        int numaNode;
+        int l3Domain;  // lowest hardware thread sharing the L3 cache
+    };
+
+    std::vector<Cpu> cpus;                 // online hardware threads, indexed by position not by id
+    std::vector<std::vector<int>> cores;   // hardware threads of each physical core, SMT siblings together
+    int numNumaNodes = 1;
+    int numL3Domains = 1;
+
+    /* Reads topology of online hardware threads, restricted to @allowed ones. */
+    static CpuTopology fromSysfs(const cpu_set_t& allowed);
+
+    const Cpu& cpu(int id) const;
+};
+
+/*
+    Placement of process'es threads on hardware threads of the node.
+    Processes of the node are ordered by dense matrix replication group and then by id, so that processes
+    reducing C together get neighbouring cores, i.e. share NUMA node and L3 domain whenever possible. Each
+    process gets an equal contiguous range of physical cores (in NUMA node, L3 domain order), its threads
+    take the first hardware thread of consecutive cores of the range and then their SMT siblings. Helper threads
+    never share the hardware thread of the main thread, which drives MPI, they are left unpinned when
+    the process has no other one.
+*/
+class Placement {
+public:
+    static const int MAIN_THREAD = 0;
+    static const int COMPUTE_THREAD = 1;
+    static const int FIRST_IO_THREAD = 2;
+
+    bool pinned = false;         // whether threads are pinned, otherwise launcher's binding is left intact
+    int nodeProcessId = 0;
+    int numNodeProcesses = 1;
+    std::vector<int> cpus;       // hardware threads assigned to the process, in order of threads using them
+    std::string launcherCpus;    // hardware threads the process was bound to by the launcher
+    std::vector<std::string> warnings;  // pinning mistakes of the launcher, detected on the node
+
+    Placement() = default;
+
+    /*
+        Reads topology of the node, detects launcher's pinning mistakes and, if @pin, computes placement.
+        Collective over all processes.
+    */
+    static Placement ofProcess(int processId, int denseGroupId, bool pin);
+
+    /* Pins calling thread playing role @thread, no-op if threads are not pinned or no hardware thread is left. */
+    void pinThread(int thread) const;
+
+    /* Gathers descriptions of all processes'es placements at @root. Collective over all processes. */
+    std::vector<std::string> gatherDescriptions(int root) const;
+
+private:
+    std::string description;
+
+    // helper threads wrap around the hardware threads following the one of the main thread
+    int cpuOfThread(int thread) const {
+        return thread == MAIN_THREAD ? this->cpus[0] : this->cpus[1 + (thread - 1) % (this->cpus.size() - 1)];
+    }
+};
+
+#endif /* __AFFINITY_H__ */
@@ -23,4 +23,55 @@ static inline std::ostream& operator<<(std::ostream& os, Algorithm algorithm) {
     return os;
 }
 
+// Transport of sparse matrix fragments through the ring of replication groups
+enum class Transport { InterComm, Neighborhood };
+
+static inline std::ostream& operator<<(std::ostream& os, Transport transport) {
+    switch (transport) {
+        case Transport::InterComm:
+            os << "InterComm";
+            break;
+        case Transport::Neighborhood:
+            os << "Neighborhood";
+            break;
+    }
+    return os;
+}
+
+// Order of tiles of sparse matrix fragments multiplied in tiled form, None if fragments are not tiled
+enum class TileOrder { None, Morton, Hilbert };
+
+static inline std::ostream& operator<<(std::ostream& os, TileOrder tileOrder) {
+    switch (tileOrder) {
+        case TileOrder::None:
+            os << "None";
+            break;
+        case TileOrder::Morton:
+            os << "Morton";
+            break;
+        case TileOrder::Hilbert:
+            os << "Hilbert";
+            break;
+    }
+    return os;
+}
+
+/* Whether the multiplication takes the dense fallback of repeated squaring (see dense_power.h). */
+enum class DenseFallback { Auto, Never, Always };
+
+static inline std::ostream& operator<<(std::ostream& os, DenseFallback denseFallback) {
+    switch (denseFallback) {
+        case DenseFallback::Auto:
+            os << "Auto";
+            break;
+        case DenseFallback::Never:
+            os << "Never";
+            break;
+        case DenseFallback::Always:
+            os << "Always";
+            break;
+    }
+    return os;
+}
+
 #endif /* __COMMON_H__ */
\ No newline at end of file
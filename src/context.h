@@ -3,8 +3,11 @@
 
 #include <mpi.h>
 #include <cassert>
+#include <string>
 
+#include "affinity.h"
 #include "common.h"
+#include "net_model.h"
 #include "program_options.h"
 #include "replication_group.h"
 
@@ -17,6 +20,13 @@ public:
     const int matrixDimension;
     const MPI_Comm globalComm = MPI_COMM_WORLD;
     const Algorithm algorithm;
+    const int numStripes;  // number of concurrent stripes large sparse matrix transfers are split into
+    const bool offload;    // kernels run on a compute thread, while the main thread keeps progressing MPI
+    const Transport transport;  // transport of sparse matrix fragments through the ring
+    const double heartbeatInterval;   // seconds between progress reports of the main leader, 0 if disabled
+    const std::string heartbeatFile;  // file progress reports are written to, stderr if empty
+    const NetModel netModel;          // latency and bandwidth MPI transfers of the multiplication are slowed down to
+    const TileOrder tileOrder;        // order of tiles of fragments, which are not narrow, None if not tiled
 
     class ProcessInfo {
     public:
@@ -35,15 +45,33 @@ public:
         
     };
     ProcessInfo process;
+    const Placement placement;  // placement of process'es threads on the node
 
-    Context(int processId, int numProcesses, int matrixDimension, int replicationGroupSize, Algorithm algorithm)
+    Context(int processId, int numProcesses, int matrixDimension, int replicationGroupSize, Algorithm algorithm,
+            int numStripes = 1, bool offload = false, Transport transport = Transport::InterComm, bool pin = false,
+            double heartbeatInterval = 0.0, const std::string& heartbeatFile = "", NetModel netModel = NetModel(),
+            TileOrder tileOrder = TileOrder::None)
         : numProcesses(numProcesses),
           numReplicationGroups(numProcesses / replicationGroupSize),
           replicationGroupSize(replicationGroupSize),
           numReplicationLayers(replicationGroupSize),
           matrixDimension(matrixDimension),
           algorithm(algorithm),
-          process(processId, numProcesses, numReplicationGroups, replicationGroupSize, algorithm) {}
+          numStripes(numStripes),
+          offload(offload),
+          transport(transport),
+          heartbeatInterval(heartbeatInterval),
+          heartbeatFile(heartbeatFile),
+          netModel(netModel),
+          tileOrder(tileOrder),
+          process(processId, numProcesses, numReplicationGroups, replicationGroupSize, algorithm),
+          placement(Placement::ofProcess(processId, process.denseRG.id, pin)) {
+        placement.pinThread(Placement::MAIN_THREAD);
+        process.sparseRG.createStripeComms(numStripes);
+        if (transport == Transport::Neighborhood) {
+            process.sparseRG.createRingComms(numStripes);
+        }
+    }
 };
 
 #endif /* __CONTEXT_H__ */
\ No newline at end of file
@@ -0,0 +1,289 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "decompression.h"
+
+const DecompressingStreamBuf::int_type EOF_VALUE = DecompressingStreamBuf::traits_type::eof();
+
+Compression detectCompression(const std::string& fileName) {
+    unsigned char magic[4] = {0, 0, 0, 0};
+    std::ifstream file(fileName, std::ios::binary);
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+
+    if (magic[0] == 0x1f && magic[1] == 0x8b) {
+        return Compression::Gzip;
+    } else if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+FILE* openCompressedFile(const std::string& fileName) {
+    FILE* file = std::fopen(fileName.c_str(), "rb");
+    if (file == nullptr) {
+        throw "Cannot open compressed input file";
+    }
+    return file;
+}
+
+// Size of chunks compressed data is read in
+const int INPUT_CHUNK_SIZE = 1 << 18;
+
+#ifdef HAVE_ZLIB
+/*
+    Decodes gzip (or zlib) data, including concatenated gzip members.
+*/
+class GzipDecoder : public Decoder {
+public:
+    explicit GzipDecoder(const std::string& fileName) : file(openCompressedFile(fileName)), input(INPUT_CHUNK_SIZE) {
+        std::memset(&this->stream, 0, sizeof(this->stream));
+        if (inflateInit2(&this->stream, 15 + 32) != Z_OK) {  // automatic gzip / zlib header detection
+            std::fclose(this->file);
+            throw "Cannot initialize zlib";
+        }
+    }
+
+    ~GzipDecoder() {
+        inflateEnd(&this->stream);
+        std::fclose(this->file);
+    }
+
+    int read(char* out, int capacity) override {
+        this->stream.next_out = reinterpret_cast<Bytef*>(out);
+        this->stream.avail_out = capacity;
+
+        while (this->stream.avail_out > 0) {
+            if (this->stream.avail_in == 0 && !this->inputEnded) {
+                size_t numRead = std::fread(this->input.data(), 1, this->input.size(), this->file);
+                if (numRead == 0 && std::ferror(this->file)) {
+                    throw "Cannot read compressed input file";
+                }
+                this->inputEnded = numRead == 0;
+                this->stream.next_in = this->input.data();
+                this->stream.avail_in = numRead;
+            }
+
+            unsigned int availOutBefore = this->stream.avail_out;
+            int result = inflate(&this->stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                this->memberEnded = true;
+                inflateReset(&this->stream);  // next gzip member may follow
+            } else if (result == Z_OK) {
+                this->memberEnded = false;
+            } else if (result != Z_BUF_ERROR) {
+                throw "Corrupted gzip input";
+            }
+
+            if (this->inputEnded && this->stream.avail_in == 0 && this->stream.avail_out == availOutBefore) {
+                if (!this->memberEnded) {
+                    throw "Truncated gzip input";
+                }
+                break;
+            }
+        }
+        return capacity - this->stream.avail_out;
+    }
+
+private:
+    FILE* file;
+    z_stream stream;
+    std::vector<Bytef> input;
+    bool inputEnded = false;
+    bool memberEnded = false;
+};
+#endif
+
+#ifdef HAVE_ZSTD
+/*
+    Decodes zstd data, including concatenated frames.
+*/
+class ZstdDecoder : public Decoder {
+public:
+    explicit ZstdDecoder(const std::string& fileName)
+        : file(openCompressedFile(fileName)), stream(ZSTD_createDStream()), input(ZSTD_DStreamInSize()) {
+        if (this->stream == nullptr || ZSTD_isError(ZSTD_initDStream(this->stream))) {
+            ZSTD_freeDStream(this->stream);
+            std::fclose(this->file);
+            throw "Cannot initialize zstd";
+        }
+        this->inBuffer = {this->input.data(), 0, 0};
+    }
+
+    ~ZstdDecoder() {
+        ZSTD_freeDStream(this->stream);
+        std::fclose(this->file);
+    }
+
+    int read(char* out, int capacity) override {
+        ZSTD_outBuffer outBuffer = {out, (size_t)capacity, 0};
+
+        while (outBuffer.pos < outBuffer.size) {
+            if (this->inBuffer.pos == this->inBuffer.size && !this->inputEnded) {
+                size_t numRead = std::fread(this->input.data(), 1, this->input.size(), this->file);
+                if (numRead == 0 && std::ferror(this->file)) {
+                    throw "Cannot read compressed input file";
+                }
+                this->inputEnded = numRead == 0;
+                this->inBuffer = {this->input.data(), numRead, 0};
+            }
+
+            size_t outPosBefore = outBuffer.pos;
+            size_t result = ZSTD_decompressStream(this->stream, &outBuffer, &this->inBuffer);
+            if (ZSTD_isError(result)) {
+                throw "Corrupted zstd input";
+            }
+            this->frameEnded = result == 0;
+
+            if (this->inputEnded && this->inBuffer.pos == this->inBuffer.size && outBuffer.pos == outPosBefore) {
+                if (!this->frameEnded) {
+                    throw "Truncated zstd input";
+                }
+                break;
+            }
+        }
+        return outBuffer.pos;
+    }
+
+private:
+    FILE* file;
+    ZSTD_DStream* stream;
+    std::vector<char> input;
+    ZSTD_inBuffer inBuffer;
+    bool inputEnded = false;
+    bool frameEnded = true;
+};
+#endif
+
+std::unique_ptr<Decoder> Decoder::open(const std::string& fileName, Compression compression) {
+    switch (compression) {
+        case Compression::Gzip:
+#ifdef HAVE_ZLIB
+            return std::unique_ptr<Decoder>(new GzipDecoder(fileName));
+#else
+            throw "Input is gzip-compressed, but zlib was not found at configure time";
+#endif
+        case Compression::Zstd:
+#ifdef HAVE_ZSTD
+            return std::unique_ptr<Decoder>(new ZstdDecoder(fileName));
+#else
+            throw "Input is zstd-compressed, but libzstd was not found at configure time";
+#endif
+        default:
+            throw "should not happen";
+    }
+}
+
+DecompressingStreamBuf::DecompressingStreamBuf(const std::string& fileName, Compression compression)
+    : decoder(Decoder::open(fileName, compression)) {
+    for (Block& block : this->blocks) {
+        block.data.resize(BLOCK_SIZE);
+    }
+    this->producer = std::thread(&DecompressingStreamBuf::produce, this);
+}
+
+DecompressingStreamBuf::~DecompressingStreamBuf() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->blockChanged.notify_all();
+    this->producer.join();
+}
+
+void DecompressingStreamBuf::produce() {
+    try {
+        for (int index = 0;; index ^= 1) {
+            Block& block = this->blocks[index];
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->blockChanged.wait(lock, [&] { return !block.ready || this->stopping; });
+                if (this->stopping) {
+                    return;
+                }
+            }
+
+            // block is not ready, thus the consumer does not touch it
+            int size = 0;
+            while (size < BLOCK_SIZE) {
+                int numDecoded = this->decoder->read(block.data.data() + size, BLOCK_SIZE - size);
+                if (numDecoded == 0) {
+                    break;
+                }
+                size += numDecoded;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                block.size = size;
+                block.ready = size > 0;
+                this->producerDone = size < BLOCK_SIZE;
+            }
+            this->blockChanged.notify_all();
+            if (size < BLOCK_SIZE) {
+                return;
+            }
+        }
+    } catch (const char* error) {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->error = error;
+            this->producerDone = true;
+        }
+        this->blockChanged.notify_all();
+    }
+}
+
+DecompressingStreamBuf::int_type DecompressingStreamBuf::underflow() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->current >= 0 && this->blocks[this->current].ready) {
+        // current block is fully consumed, hand it back to the producer
+        this->blocks[this->current].ready = false;
+        this->blockChanged.notify_all();
+    }
+
+    int next = (this->current + 1) % 2;
+    this->blockChanged.wait(lock, [&] { return this->blocks[next].ready || this->producerDone; });
+    if (!this->blocks[next].ready) {
+        if (this->error) {
+            throw this->error;
+        }
+        return EOF_VALUE;
+    }
+
+    this->current = next;
+    char* data = this->blocks[next].data.data();
+    this->setg(data, data, data + this->blocks[next].size);
+    return traits_type::to_int_type(*this->gptr());
+}
+
+/*
+    Decompression errors thrown by the stream buffer are rethrown to the parser, as badbit is in
+    the exception mask.
+*/
+class DecompressingInputStream : public std::istream {
+public:
+    DecompressingInputStream(const std::string& fileName, Compression compression)
+        : std::istream(nullptr), buffer(fileName, compression) {
+        this->rdbuf(&this->buffer);
+        this->exceptions(std::ios::badbit);
+    }
+
+private:
+    DecompressingStreamBuf buffer;
+};
+
+std::unique_ptr<std::istream> openInputStream(const std::string& fileName) {
+    Compression compression = detectCompression(fileName);
+    if (compression == Compression::None) {
+        return std::unique_ptr<std::istream>(new std::ifstream(fileName));
+    }
+    return std::unique_ptr<std::istream>(new DecompressingInputStream(fileName, compression));
+}
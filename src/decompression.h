@@ -0,0 +1,69 @@
+#ifndef __DECOMPRESSION_H__
+#define __DECOMPRESSION_H__
+
+#include <condition_variable>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Compression { None, Gzip, Zstd };
+
+/* Detects compression of file @fileName by its magic bytes. */
+Compression detectCompression(const std::string& fileName);
+
+/* Source of decompressed data, implemented for each library found at configure time. */
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+
+    /* Decompresses up to @capacity bytes into @out, returns number of bytes written, 0 at the end of data. */
+    virtual int read(char* out, int capacity) = 0;
+
+    static std::unique_ptr<Decoder> open(const std::string& fileName, Compression compression);
+};
+
+/*
+    Input stream buffer decompressing a file in a pipeline of two blocks: a producer thread decompresses
+    the next block, while the consumer parses the current one.
+*/
+class DecompressingStreamBuf : public std::streambuf {
+public:
+    DecompressingStreamBuf(const std::string& fileName, Compression compression);
+    ~DecompressingStreamBuf();
+
+    DecompressingStreamBuf(const DecompressingStreamBuf& other) = delete;
+    DecompressingStreamBuf& operator=(const DecompressingStreamBuf& other) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    struct Block {
+        std::vector<char> data;
+        int size = 0;
+        bool ready = false;  // filled by the producer and not yet consumed
+    };
+
+    static const int BLOCK_SIZE = 1 << 20;
+
+    std::unique_ptr<Decoder> decoder;
+    Block blocks[2];
+    int current = -1;  // block being consumed
+    bool producerDone = false;
+    bool stopping = false;
+    const char* error = nullptr;
+    std::mutex mutex;
+    std::condition_variable blockChanged;
+    std::thread producer;
+
+    void produce();
+};
+
+/* Input stream of file @fileName, decompressed on the fly if compressed. Errors are thrown as strings. */
+std::unique_ptr<std::istream> openInputStream(const std::string& fileName);
+
+#endif /* __DECOMPRESSION_H__ */
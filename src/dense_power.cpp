@@ -0,0 +1,216 @@
+#include <mpi.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "dense_power.h"
+#include "mpi_helpers.h"
+#include "stats.h"
+#include "utils.h"
+
+// Cost of a multiply-add of the dense kernel relative to one of the sparse kernel, which loads indices
+// along with every value and does not vectorize (measured on matrices of n = 500 and 2000)
+const double DENSE_OPERATION_COST = 0.08;
+
+// Cost of a shift of the ring in operations of the sparse kernel, covering the latency of the fragment transfer
+// and the scheduling of its tasks, which small fragments are unable to hide (measured about 100us)
+const double SHIFT_COST = 3e4;
+
+// Cost of a value received by the allgather of a dense product, in operations of the sparse kernel
+const double GATHERED_VALUE_COST = 1.0;
+
+// Rows and columns of blocks of the left matrix of the dense kernel, a block of doubles fits in L2 cache
+const int DENSE_BLOCK_SIZE = 128;
+
+// Number of dense products of repeated squaring, besides the final product with B
+int numSquaringProducts(int exponent) {
+    int numProducts = 0;
+    for (int e = exponent; e > 1; e /= 2) {
+        numProducts += 1 + (e % 2);  // squaring, and multiplication of the accumulated power for odd bits
+    }
+    return numProducts;
+}
+
+DensePlan planDenseFallback(Context& ctx, const SparseMatrix& localA, const DenseMatrix& B, int exponent,
+                            DenseFallback mode) {
+    // nonzero values of the whole matrix, and columns of the whole B, counted once per dense replication group
+    long long local[2] = {localA.nonZeros(), ctx.process.denseRG.isLeader(ctx.process.id) ? B.dimension.col : 0};
+    long long global[2];
+    MPI_Allreduce(local, global, 2, MPI_LONG_LONG, MPI_SUM, ctx.globalComm);
+    stats::add(stats::Counter::WorldBytes, sizeof(local));
+
+    double n = ctx.matrixDimension;
+    double numColumnsB = global[1];
+    double p = ctx.numProcesses;
+    int numShifts = ctx.algorithm == Algorithm::ColumnA ? ctx.numReplicationGroups
+                                                         : ctx.numReplicationGroups / ctx.replicationGroupSize;
+
+    DensePlan plan;
+    plan.sparseCost = exponent * (global[0] * numColumnsB / p + numShifts * SHIFT_COST);
+    double productCost = DENSE_OPERATION_COST * n * n * n / p + GATHERED_VALUE_COST * n * n;
+    plan.denseCost = global[0] * GATHERED_VALUE_COST + numSquaringProducts(exponent) * productCost +
+                     DENSE_OPERATION_COST * n * n * numColumnsB / p;
+
+    switch (mode) {
+        case DenseFallback::Auto:
+            plan.useDense = ctx.matrixDimension <= DENSE_FALLBACK_MAX_DIMENSION && plan.denseCost < plan.sparseCost;
+            break;
+        case DenseFallback::Never:
+            plan.useDense = false;
+            break;
+        case DenseFallback::Always:
+            plan.useDense = true;
+            break;
+    }
+    return plan;
+}
+
+/*
+    Perform C = X * Y on columns [colStart, colEnd) of Y, into @C holding only those columns. Matrices are
+    column-major with @n rows, X is n x n. Blocks of X are reused by all the columns, before moving to the next.
+*/
+void denseMultiply(const double* X, const double* Y, double* C, int n, int colStart, int colEnd) {
+    stats::PhaseScope phase(stats::Phase::Kernel);
+    stats::add(stats::Counter::DenseProducts, 1);
+    std::fill(C, C + (size_t)n * (colEnd - colStart), 0.0);
+    for (int kb = 0; kb < n; kb += DENSE_BLOCK_SIZE) {
+        int kEnd = std::min(kb + DENSE_BLOCK_SIZE, n);
+        for (int ib = 0; ib < n; ib += DENSE_BLOCK_SIZE) {
+            int iEnd = std::min(ib + DENSE_BLOCK_SIZE, n);
+            for (int j = colStart; j < colEnd; j++) {
+                const double* columnY = Y + (size_t)j * n;
+                double* columnC = C + (size_t)(j - colStart) * n;
+                for (int k = kb; k < kEnd; k++) {
+                    double y = columnY[k];
+                    if (y == 0.0) {
+                        continue;
+                    }
+                    const double* columnX = X + (size_t)k * n;
+                    for (int i = ib; i < iEnd; i++) {
+                        columnC[i] += columnX[i] * y;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+    Perform C = X * Y of n x n matrices, known by all processes. Each process computes its fair part of columns,
+    which are allgathered, so all processes know C.
+*/
+void distributedMultiply(Context& ctx, const DenseMatrix& X, const DenseMatrix& Y, DenseMatrix& C) {
+    int n = ctx.matrixDimension;
+    std::vector<int> counts(ctx.numProcesses), displacements(ctx.numProcesses);
+    for (int p = 0; p < ctx.numProcesses; p++) {
+        int colStart = utils::getFairPartBeginning(p, n, ctx.numProcesses);
+        int colEnd = utils::getFairPartBeginning(p + 1, n, ctx.numProcesses);
+        counts[p] = (colEnd - colStart) * n;
+        displacements[p] = colStart * n;
+    }
+
+    int id = ctx.process.id;
+    denseMultiply(X.data.data(), Y.data.data(), C.data.data() + displacements[id], n, displacements[id] / n,
+                  (displacements[id] + counts[id]) / n);
+
+    stats::PhaseScope phase(stats::Phase::Gather);
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, C.data.data(), counts.data(), displacements.data(), MPI_DOUBLE,
+                   ctx.globalComm);
+    stats::add(stats::Counter::WorldBytes, ((long long)n * n - counts[id]) * sizeof(double));
+}
+
+// Dense whole matrix on every process, joined from the parts of all processes
+DenseMatrix densify(Context& ctx, SparseMatrix& localA) {
+    PackedData packed = pack<SparseMatrix>(localA, ctx.globalComm);
+    int size = packed.size();
+    std::vector<int> sizes(ctx.numProcesses), displacements(ctx.numProcesses);
+    MPI_Allgather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, ctx.globalComm);
+    int totalSize = 0;
+    for (int p = 0; p < ctx.numProcesses; p++) {
+        displacements[p] = totalSize;
+        totalSize += sizes[p];
+    }
+
+    PackedData gathered(totalSize);
+    {
+        stats::PhaseScope phase(stats::Phase::Gather);
+        MPI_Allgatherv(packed.data(), size, MPI_PACKED, gathered.data(), sizes.data(), displacements.data(),
+                       MPI_PACKED, ctx.globalComm);
+        stats::add(stats::Counter::WorldBytes, totalSize - size);
+    }
+
+    int n = ctx.matrixDimension;
+    DenseMatrix A = DenseMatrix::blank({n, n});
+    stats::PhaseScope phase(stats::Phase::Unpack);
+    for (int p = 0; p < ctx.numProcesses; p++) {
+        SparseMatrix part = unpack<SparseMatrix>(gathered.data() + displacements[p], sizes[p], ctx.globalComm);
+        for (auto field : part) {
+            MatrixIndex idx;
+            double value;
+            std::tie(idx, value) = field;
+            A(idx.row, idx.col) = value;
+        }
+    }
+    return A;
+}
+
+/*
+    Powers are computed from the lowest bit of the exponent: @power holds A^(2^i) and @result the product of
+    powers of the bits seen so far. Every product is distributed over all processes, so all of them know
+    A^exponent in the end. The fragment of B is then multiplied locally, split among the members of the dense
+    replication group, which all hold the same fragment and share the result, as after the reduction of the ring.
+*/
+DenseMatrix multiplyDense(Context& ctx, SparseMatrix& localA, DenseMatrix&& inB, int exponent) {
+    DenseMatrix B = std::move(inB);
+    int n = ctx.matrixDimension;
+    if (exponent == 0) {
+        return B;
+    }
+
+    DenseMatrix power = densify(ctx, localA);
+    DenseMatrix result, product = DenseMatrix::blank({n, n});
+    bool hasResult = false;
+    for (int e = exponent; e > 0; e /= 2) {
+        if (e % 2 == 1) {
+            if (hasResult) {
+                distributedMultiply(ctx, result, power, product);
+                std::swap(result, product);
+            } else {
+                result = DenseMatrix::blank({n, n});
+                result.data = power.data;
+                hasResult = true;
+            }
+        }
+        if (e > 1) {
+            distributedMultiply(ctx, power, power, product);
+            std::swap(power, product);
+        }
+    }
+    power = DenseMatrix();
+    product = DenseMatrix();
+
+    const ReplicationGroup& rg = ctx.process.denseRG;
+    int numColumns = B.dimension.col;
+    std::vector<int> counts(rg.size), displacements(rg.size);
+    for (int m = 0; m < rg.size; m++) {
+        int colStart = utils::getFairPartBeginning(m, numColumns, rg.size);
+        int colEnd = utils::getFairPartBeginning(m + 1, numColumns, rg.size);
+        counts[m] = (colEnd - colStart) * n;
+        displacements[m] = colStart * n;
+    }
+
+    int memberId = 0;
+    if (rg.size > 1) {
+        MPI_Comm_rank(rg.internalComm, &memberId);
+    }
+    DenseMatrix C = DenseMatrix::blank(B.dimension);
+    denseMultiply(result.data.data(), B.data.data(), C.data.data() + displacements[memberId], n,
+                  displacements[memberId] / n, (displacements[memberId] + counts[memberId]) / n);
+    if (rg.size > 1) {
+        stats::PhaseScope phase(stats::Phase::Gather);
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DOUBLE, C.data.data(), counts.data(), displacements.data(), MPI_DOUBLE,
+                       rg.internalComm);
+        stats::add(stats::Counter::DenseBytes, ((long long)B.data.size() - counts[memberId]) * sizeof(double));
+    }
+    return C;
+}
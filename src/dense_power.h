@@ -0,0 +1,40 @@
+#ifndef __DENSE_POWER_H__
+#define __DENSE_POWER_H__
+
+#include "common.h"
+#include "context.h"
+#include "matrix.h"
+
+/*
+    Dense fallback of the multiplication: A is densified on every process and A^exponent is computed by repeated
+    squaring, in about log2(exponent) dense products, followed by a single product with the fragment of B.
+    It pays off for small matrices multiplied many times, where the ring does exponent * numShifts
+    synchronizations of fragments, which are too small to hide their latency, while the dense products are
+    a few cache-friendly kernels.
+*/
+
+/* Largest matrix dimension the fallback is taken for, even if forced, each process holds three n x n matrices. */
+const int DENSE_FALLBACK_MAX_DIMENSION = 4096;
+
+/* Estimated costs of the multiplication, in operations of the sparse kernel on the slowest process. */
+struct DensePlan {
+    bool useDense = false;
+    double sparseCost = 0.0;
+    double denseCost = 0.0;
+};
+
+/*
+    Decides whether the multiplication takes the dense fallback, comparing estimated costs of both, unless
+    @mode forces the decision. @localA is the part of the sparse matrix scattered to the process.
+    Collective over all processes, which all get the same plan.
+*/
+DensePlan planDenseFallback(Context& ctx, const SparseMatrix& localA, const DenseMatrix& B, int exponent,
+                            DenseFallback mode);
+
+/*
+    Computes the fragment of A^exponent * B of the process, the same as multiply() does. @localA is the part of
+    the sparse matrix scattered to the process, parts of all processes make up the whole matrix.
+*/
+DenseMatrix multiplyDense(Context& ctx, SparseMatrix& localA, DenseMatrix&& B, int exponent);
+
+#endif /* __DENSE_POWER_H__ */
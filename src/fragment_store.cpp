@@ -0,0 +1,165 @@
+#include <fcntl.h>
+#include <mpi.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "context.h"
+#include "fragment_store.h"
+#include "matrix.h"
+#include "mpi_helpers.h"
+#include "stats.h"
+#include "utils.h"
+
+void writeFully(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written <= 0) {
+            throw "Cannot write fragment file";
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+void writeFragmentFile(const std::string& path, const char* data, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw "Cannot create fragment file";
+    }
+    writeFully(fd, data, size);
+    close(fd);
+}
+
+PackedData readFragmentFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0) {
+        throw "Cannot open fragment file";
+    }
+
+    PackedData data(status.st_size);
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t numRead = pread(fd, data.data() + offset, data.size() - offset, offset);
+        if (numRead <= 0) {
+            throw "Cannot read fragment file";
+        }
+        offset += numRead;
+    }
+    close(fd);
+    return data;
+}
+
+// Waits for the write of the node writer, which fails the whole job, as no process could read the fragment
+void waitForWrite(std::future<void>& write, const std::string& scratchDir) {
+    if (!write.valid()) {
+        return;
+    }
+    stats::PhaseScope phase(stats::Phase::Wait);
+    try {
+        write.get();
+    } catch (const char* error) {
+        utils::abortWithError(std::string(error) + " in " + scratchDir);
+    }
+}
+
+FragmentStore FragmentStore::create(Context& ctx, SparseMatrix&& inFragment, const std::string& scratchDir) {
+    SparseMatrixReplicationGroup& rg = ctx.process.sparseRG;
+
+    MPI_Comm nodeComm;
+    int nodeProcessId;
+    MPI_Comm_split_type(ctx.globalComm, MPI_COMM_TYPE_SHARED, ctx.process.id, MPI_INFO_NULL, &nodeComm);
+    MPI_Comm_rank(nodeComm, &nodeProcessId);
+
+    int jobId = getpid();
+    MPI_Bcast(&jobId, 1, MPI_INT, MAIN_LEADER_ID, ctx.globalComm);
+
+    FragmentStore store(scratchDir, jobId, nodeComm, nodeProcessId == 0, ctx.numReplicationGroups, &ctx.placement);
+    struct stat status;
+    if (store.isNodeWriter && (stat(scratchDir.c_str(), &status) != 0 || !S_ISDIR(status.st_mode) ||
+                               access(scratchDir.c_str(), W_OK | X_OK) != 0)) {
+        utils::abortWithError("Scratch directory " + scratchDir + " does not exist or is not writable");
+    }
+
+    // Fragments are written packed, in the background, while the following ones are passed through the ring.
+    // Nothing is unpacked, the process holds only the two packed buffers of the transfer, as the ring does.
+    SparseMatrix fragment = std::move(inFragment);
+    stats::setFragmentNonZeros(fragment.nonZeros());
+    PackedData sendData, recvData;
+    int isRGLeader = rg.isLeader(ctx.process.id);
+    if (isRGLeader || store.isNodeWriter) {
+        stats::PhaseScope phase(stats::Phase::Pack);
+        sendData = pack<SparseMatrix>(fragment, rg.predInterComm);
+    }
+    fragment = SparseMatrix();
+
+    std::future<void> write, prevWrite;  // writes of the fragments in @sendData and @recvData
+    for (int k = 0; k < ctx.numReplicationGroups; k++) {
+        int fragmentRgId = (rg.id + k) % ctx.numReplicationGroups;
+        if (store.isNodeWriter) {
+            std::string path = store.fragmentPath(fragmentRgId);
+            const char* data = sendData.data();  // buffer itself stays in place, when swapped with the other one
+            size_t size = sendData.size();
+            write = store.ioPool->submit([path, data, size] { writeFragmentFile(path, data, size); });
+        }
+
+        if (k != ctx.numReplicationGroups - 1) {
+            MPI_Request sendReq, recvReq;
+            int sendSize, recvSize;
+            if (isRGLeader) {
+                sendSize = sendData.size();
+                MPI_Ibcast(&sendSize, 1, MPI_INT, MPI_ROOT, rg.predInterComm, &sendReq);
+            }
+            MPI_Ibcast(&recvSize, 1, MPI_INT, INTERNAL_LEADER_ID, rg.succInterComm, &recvReq);
+            MPI_Wait(&recvReq, MPI_STATUS_IGNORE);
+            if (isRGLeader) {
+                MPI_Wait(&sendReq, MPI_STATUS_IGNORE);
+                MPI_Ibcast(sendData.data(), sendData.size(), MPI_PACKED, MPI_ROOT, rg.predInterComm, &sendReq);
+            }
+            // receive buffer holds the previous fragment, until it is written
+            waitForWrite(prevWrite, scratchDir);
+            recvData.resize(recvSize);
+            MPI_Ibcast(recvData.data(), recvData.size(), MPI_PACKED, INTERNAL_LEADER_ID, rg.succInterComm, &recvReq);
+            MPI_Wait(&recvReq, MPI_STATUS_IGNORE);
+            if (isRGLeader) {
+                MPI_Wait(&sendReq, MPI_STATUS_IGNORE);
+            }
+            stats::add(stats::Counter::RingBytes, recvData.size() + (isRGLeader ? sendData.size() : 0));
+
+            std::swap(sendData, recvData);
+            std::swap(write, prevWrite);
+        }
+    }
+
+    waitForWrite(write, scratchDir);
+    waitForWrite(prevWrite, scratchDir);
+    // fragments written by the node writer have to be complete, before any process of the node reads them
+    MPI_Barrier(nodeComm);
+
+    return store;
+}
+
+std::future<void> FragmentStore::prefetch(int rgId, PackedData& destination) {
+    std::string path = this->fragmentPath(rgId);
+    PackedData* dest = &destination;
+    return this->ioPool->submit([path, dest] { *dest = readFragmentFile(path); });
+}
+
+void FragmentStore::close() {
+    MPI_Barrier(this->nodeComm);
+    if (this->isNodeWriter) {
+        for (int rgId = 0; rgId < this->numReplicationGroups; rgId++) {
+            unlink(this->fragmentPath(rgId).c_str());
+        }
+    }
+    MPI_Comm_free(&this->nodeComm);
+    this->ioPool.reset();
+}
+
+std::string FragmentStore::fragmentPath(int rgId) const {
+    return this->scratchDir + "/matrixmul-" + std::to_string(this->jobId) + "-" + std::to_string(rgId) + ".packed";
+}
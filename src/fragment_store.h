@@ -0,0 +1,64 @@
+#ifndef __FRAGMENT_STORE_H__
+#define __FRAGMENT_STORE_H__
+
+#include <mpi.h>
+
+#include <future>
+#include <memory>
+#include <string>
+
+#include "common.h"
+#include "context.h"
+#include "matrix.h"
+#include "thread_pool.h"
+
+/*
+    Sparse matrix fragments of all replication groups kept on node-local scratch. A file holds the fragment
+    exactly as packed for the transfer through the ring (see pack<SparseMatrix>), which is valid within the job
+    and the node only. Fragments are written once, by a single process of each node, and then read
+    asynchronously by a pool of I/O threads instead of being passed through the ring of replication groups,
+    to be unpacked by the reader as if received.
+*/
+class FragmentStore {
+public:
+    FragmentStore(FragmentStore&& other) = default;
+    FragmentStore& operator=(FragmentStore&& other) = default;
+    ~FragmentStore() = default;
+
+    /*
+        Passes @fragment of process'es replication group once through the whole ring, so that each
+        replication group's fragment is written to @scratchDir of every node. Collective over all processes.
+    */
+    static FragmentStore create(Context& ctx, SparseMatrix&& fragment, const std::string& scratchDir);
+
+    /* Starts asynchronous read of packed fragment of replication group @rgId into @destination. */
+    std::future<void> prefetch(int rgId, PackedData& destination);
+
+    /* Removes fragments from scratch, once all processes of the node are done. Collective over all processes. */
+    void close();
+
+private:
+    std::string scratchDir;
+    int jobId;                          // distinguishes files of jobs sharing the scratch
+    MPI_Comm nodeComm = MPI_COMM_NULL;  // processes sharing the node-local scratch
+    bool isNodeWriter;                  // whether process writes and removes fragments of the node
+    int numReplicationGroups;
+    std::unique_ptr<ThreadPool> ioPool;
+
+    FragmentStore(const std::string& scratchDir, int jobId, MPI_Comm nodeComm, bool isNodeWriter,
+                  int numReplicationGroups, const Placement* placement)
+        : scratchDir(scratchDir),
+          jobId(jobId),
+          nodeComm(nodeComm),
+          isNodeWriter(isNodeWriter),
+          numReplicationGroups(numReplicationGroups),
+          ioPool(new ThreadPool(NUM_IO_THREADS, [placement](int worker) {
+              placement->pinThread(Placement::FIRST_IO_THREAD + worker);
+          })) {}
+
+    std::string fragmentPath(int rgId) const;
+
+    static const int NUM_IO_THREADS = 2;
+};
+
+#endif /* __FRAGMENT_STORE_H__ */
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "heartbeat.h"
+
+Heartbeat::Heartbeat(double interval, const std::string& fileName, int exponent, int numShifts)
+    : interval(interval),
+      fileName(fileName),
+      exponent(exponent),
+      numShifts(numShifts),
+      startTime(std::chrono::steady_clock::now()),
+      ownTimes(exponent * numShifts, -1.0) {
+    this->writer = std::thread(&Heartbeat::writeLoop, this);
+}
+
+Heartbeat::~Heartbeat() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->stopped.notify_all();
+    this->writer.join();
+}
+
+double Heartbeat::elapsed() const {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->startTime;
+    return elapsed.count();
+}
+
+void Heartbeat::shiftDone(int e, int i) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->ownTimes[(e - 1) * this->numShifts + (i - 1)] = this->elapsed();
+}
+
+void Heartbeat::shiftDoneEverywhere(int e, int i) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->numDone++;
+    this->lastExponent = e;
+    this->lastShift = i;
+    this->lastProgressTime = this->elapsed();
+    this->lag = this->lastProgressTime - this->ownTimes[(e - 1) * this->numShifts + (i - 1)];
+    this->maxLag = std::max(this->maxLag, this->lag);
+}
+
+// Writes a single report line, called with the mutex held
+void Heartbeat::write() {
+    int numTotal = this->exponent * this->numShifts;
+    double now = this->elapsed();
+    double rate = this->lastProgressTime > 0 ? this->numDone / this->lastProgressTime : 0.0;
+
+    std::stringstream ss;
+    ss << std::fixed;
+    ss.precision(3);
+    ss << "heartbeat: " << now << "s exponent " << this->lastExponent << "/" << this->exponent << " shift "
+       << this->lastShift << "/" << this->numShifts << " fragments " << this->numDone << "/" << numTotal << " rate "
+       << rate << " fragments/s";
+    if (this->stopping) {
+        ss << " done";
+    } else if (rate > 0) {
+        ss << " eta " << (numTotal - this->numDone) / rate << "s";
+    } else {
+        ss << " eta unknown";
+    }
+    ss << " lag " << this->lag << "s (max " << this->maxLag << "s) idle " << now - this->lastProgressTime << "s";
+
+    if (this->fileName.empty()) {
+        std::cerr << ss.str() << std::endl;
+    } else {
+        std::ofstream file(this->fileName, std::ios::trunc);
+        file << ss.str() << std::endl;
+    }
+}
+
+void Heartbeat::writeLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping) {
+        this->stopped.wait_for(lock, std::chrono::duration<double>(this->interval), [this] { return this->stopping; });
+        this->write();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef __HEARTBEAT_H__
+#define __HEARTBEAT_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+    Progress of the multiplication, reported by the main leader every @interval seconds by a background
+    thread (so a stalled run keeps reporting, with growing time since the last progress).
+    Shift is done on all processes, once a reduction posted by every process after finishing the shift
+    completes, thus lag between it and the main leader finishing the same shift is the lag of the slowest
+    process. The report is appended to stderr, or rewritten in @fileName if given.
+*/
+class Heartbeat {
+public:
+    Heartbeat(double interval, const std::string& fileName, int exponent, int numShifts);
+    ~Heartbeat();
+
+    Heartbeat(const Heartbeat& other) = delete;
+    Heartbeat& operator=(const Heartbeat& other) = delete;
+
+    /* Shift @i of exponent @e is done by the main leader. */
+    void shiftDone(int e, int i);
+
+    /* Shift @i of exponent @e is done by all processes. */
+    void shiftDoneEverywhere(int e, int i);
+
+private:
+    const double interval;
+    const std::string fileName;
+    const int exponent;
+    const int numShifts;
+    const std::chrono::steady_clock::time_point startTime;
+
+    std::mutex mutex;
+    std::condition_variable stopped;
+    bool stopping = false;
+    int numDone = 0;                // shifts done by all processes
+    int lastExponent = 0;           // last shift done by all processes
+    int lastShift = 0;
+    double lastProgressTime = 0.0;  // time the last shift was done by all processes, since start
+    double lag = 0.0;               // lag of the slowest process at the last shift done by all processes
+    double maxLag = 0.0;
+    std::vector<double> ownTimes;   // times the main leader finished each shift, since start
+
+    std::thread writer;
+
+    double elapsed() const;
+    void write();
+    void writeLoop();
+};
+
+#endif /* __HEARTBEAT_H__ */
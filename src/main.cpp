@@ -1,7 +1,16 @@
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <string>
+
 #include "common.h"
 #include "context.h"
+#include "dense_power.h"
+#include "fragment_store.h"
 #include "matrix.h"
 #include "multiplication.h"
+#include "profiler.h"
+#include "stats.h"
 #include "utils.h"
 
 int main(int argc, char* argv[]) {
@@ -10,8 +19,16 @@ int main(int argc, char* argv[]) {
 
     ProgramOptions options = ProgramOptions::fromCommandLine(argc, argv);
 
-    MPI_Init(&argc, &argv);
+    // Only the main thread performs MPI calls, helper threads (e.g. parser, compute thread) do not touch MPI
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
+    if (threadSupport < MPI_THREAD_FUNNELED) {
+        utils::abortWithError("MPI does not support MPI_THREAD_FUNNELED, required by helper threads");
+    }
     startTime = MPI_Wtime();
+    if (!options.profileFile.empty()) {
+        profiler::start();
+    }
 
     int numProcesses, processId;
     MPI_Comm_size(MPI_COMM_WORLD, &numProcesses);
@@ -19,32 +36,132 @@ int main(int argc, char* argv[]) {
 
     utils::verifyPreconditions(numProcesses, options.replicationGroupSize, options.algorithm);
 
-    SparseMatrix A;
+    // Main leader parses the sparse matrix in the background, while communicators are being constructed
+    std::future<SparseMatrix> parsedA;
+    MatrixDimension dimension;
     if (isMainLeader(processId)) {
-        A = std::move(SparseMatrix::fromFile(options.sparseMatrixFile));
+        try {
+            dimension = SparseMatrix::readDimension(options.sparseMatrixFile);
+        } catch (const char* error) {
+            utils::abortWithError("Cannot read sparse matrix " + options.sparseMatrixFile + ": " + error);
+        }
+        // the sparse multiplication is taken instead for larger matrices, unless forced to the fallback
+        if (options.denseFallback == DenseFallback::Always && options.outOfCoreDir.empty() &&
+            dimension.row > DENSE_FALLBACK_MAX_DIMENSION) {
+            utils::abortWithError("Dense fallback is limited to matrices of dimension up to " +
+                                  std::to_string(DENSE_FALLBACK_MAX_DIMENSION));
+        }
+        parsedA = std::async(std::launch::async, SparseMatrix::fromFile, std::ref(options.sparseMatrixFile));
     }
 
-    int matrixDimension = utils::initializeMatrixDimension(processId, A);
-    Context ctx(processId, numProcesses, matrixDimension, options.replicationGroupSize, options.algorithm);
+    int matrixDimension = utils::initializeMatrixDimension(processId, dimension);
+    Context ctx(processId, numProcesses, matrixDimension, options.replicationGroupSize, options.algorithm,
+                options.numStripes, options.offload, options.transport, options.pin,
+                options.heartbeatInterval, options.heartbeatFile, options.netModel,
+                options.tileOrder);
+
+    if ((options.printStats || options.pin) && ctx.placement.nodeProcessId == 0) {
+        for (const std::string& warning : ctx.placement.warnings) {
+            std::cerr << "warning: " << warning << std::endl;
+        }
+    }
 
-    A = utils::initializeSparseMatrix(ctx, A);
-    DenseMatrix B = utils::initializeDenseMatrix(ctx, options.denseMatrixSeed);
+    utils::SparseMatrixAssembly A;
+    DenseMatrix B;
+    std::tie(A, B) = utils::initializeMatrices(ctx, parsedA, options.denseMatrixSeed, options.sampleColumns);
     initTime = MPI_Wtime();
-    // At this point, each member of replication group stores the same fragment of sparse and dense matrices (A and B)
+    // At this point, each member of replication group stores the same fragment of dense matrix (B), while
+    // the same fragment of sparse matrix (A) is still being assembled and is completed within the first shift
 
-    DenseMatrix C = multiply(ctx, std::move(A), std::move(B), options.multiplicationExponent);
+    // Out-of-core A does not fit in memory, let alone densified
+    DensePlan plan = planDenseFallback(ctx, A.local, B, options.multiplicationExponent,
+                                       options.outOfCoreDir.empty() ? options.denseFallback : DenseFallback::Never);
+
+    DenseMatrix C;
+    std::vector<double> runTimes;
+    if (plan.useDense && ctx.heartbeatInterval > 0.0 && ctx.process.isMainLeader()) {
+        std::cerr << "warning: --heartbeat is ignored, the dense fallback takes no shifts of the ring to report"
+                  << std::endl;
+    }
+    if (plan.useDense) {
+        // the gather of the replication group is only finished, the fallback needs just the parts scattered
+        // to all processes
+        SparseMatrix remainderA = A.complete();
+        stats::setFragmentNonZeros(A.local.nonZeros() + remainderA.nonZeros());
+    }
+    if (options.repeat == 1 && plan.useDense) {
+        C = multiplyDense(ctx, A.local, std::move(B), options.multiplicationExponent);
+    } else if (options.repeat == 1 && options.outOfCoreDir.empty()) {
+        C = multiply(ctx, std::move(A), std::move(B), options.multiplicationExponent);
+    } else if (options.repeat == 1) {
+        FragmentStore store = FragmentStore::create(ctx, A.whole(), options.outOfCoreDir);
+        C = multiply(ctx, store, std::move(B), options.multiplicationExponent);
+        store.close();
+    } else {
+        // Warm runs: A is completed and retained (packed, in the store, or its scattered parts for the dense
+        // fallback), and every run starts from a retained copy of B, so only the first run pays for the cold effects
+        PackedData packedA;
+        std::unique_ptr<FragmentStore> store;
+        if (!plan.useDense && options.outOfCoreDir.empty()) {
+            SparseMatrix wholeA = A.whole();
+            packedA = pack<SparseMatrix>(wholeA, ctx.process.sparseRG.internalComm);
+        } else if (!plan.useDense) {
+            store.reset(new FragmentStore(FragmentStore::create(ctx, A.whole(), options.outOfCoreDir)));
+        }
+
+        DenseMatrix retainedB = std::move(B);
+        for (int r = 0; r < options.repeat; r++) {
+            // result of the previous run is overwritten with the copy, reusing its already touched memory
+            DenseMatrix runB = r == 0 ? DenseMatrix::blank(retainedB.dimension) : std::move(C);
+            runB.data = retainedB.data;
+
+            MPI_Barrier(ctx.globalComm);
+            double runStartTime = MPI_Wtime();
+            if (plan.useDense) {
+                C = multiplyDense(ctx, A.local, std::move(runB), options.multiplicationExponent);
+            } else if (store) {
+                C = multiply(ctx, *store, std::move(runB), options.multiplicationExponent);
+            } else {
+                C = multiply(ctx, packedA, std::move(runB), options.multiplicationExponent);
+            }
+            runTimes.push_back(MPI_Wtime() - runStartTime);
+        }
+        if (store) {
+            store->close();
+        }
+
+        // run takes as long as on the slowest process
+        MPI_Reduce(ctx.process.isMainLeader() ? MPI_IN_PLACE : runTimes.data(), runTimes.data(), runTimes.size(),
+                   MPI_DOUBLE, MPI_MAX, MAIN_LEADER_ID, ctx.globalComm);
+    }
     mulpTime = gatherTime = MPI_Wtime();
+    if (options.repeat == 1) {
+        runTimes.push_back(mulpTime - initTime);
+    }
 
     if (options.printMatrix) {
         DenseMatrix resultMatrix = utils::gatherDenseMatrix(ctx, C, MAIN_LEADER_ID);
         gatherTime = MPI_Wtime();
         if (ctx.process.isMainLeader()) {
+            stats::PhaseScope phase(stats::Phase::Print);
             resultMatrix.print();
         }
+    } else if (options.printGreaterEqual && options.sampleColumns > 0) {
+        utils::CountEstimate result =
+            utils::estimateCountGE(ctx, C, options.printGreaterEqualValue, options.denseMatrixSeed,
+                                   options.sampleColumns, MAIN_LEADER_ID);
+        gatherTime = MPI_Wtime();
+        if (ctx.process.isMainLeader()) {
+            stats::PhaseScope phase(stats::Phase::Print);
+            std::cout << std::fixed << std::setprecision(0) << result.estimate << " (95% confidence interval "
+                      << result.low << " - " << result.high << ", " << result.numSampledColumns << " of "
+                      << ctx.matrixDimension << " columns sampled)" << std::endl;
+        }
     } else if (options.printGreaterEqual) {
         int result = utils::gatherCountGE(ctx, C, options.printGreaterEqualValue, MAIN_LEADER_ID);
         gatherTime = MPI_Wtime();
         if (ctx.process.isMainLeader()) {
+            stats::PhaseScope phase(stats::Phase::Print);
             std::cout << result << std::endl;
         }
     }
@@ -52,12 +169,37 @@ int main(int argc, char* argv[]) {
     ctx.process.denseRG.freeComms();
     ctx.process.sparseRG.freeComms();
     endTime = MPI_Wtime();
+    if (!options.profileFile.empty()) {
+        profiler::stop();
+        profiler::writeProfile(ctx, options.profileFile);
+    }
+
+    if (!options.reportFile.empty()) {
+        stats::WallTimes wallTimes = {endTime - startTime, initTime - startTime, mulpTime - initTime,
+                                      gatherTime - mulpTime, runTimes};
+        stats::writeReport(ctx, options, wallTimes, plan, options.reportFile);
+    }
+
+    std::vector<std::string> placements;
+    if (options.printStats) {
+        placements = ctx.placement.gatherDescriptions(MAIN_LEADER_ID);
+    }
 
     if (options.printStats && ctx.process.isMainLeader()) {
         std::cerr << std::fixed << "execution: " << endTime - startTime << "s" << std::endl;
         std::cerr << std::fixed << "init: " << initTime - startTime << "s" << std::endl;
         std::cerr << std::fixed << "multiplication: " << mulpTime - initTime << "s" << std::endl;
         std::cerr << std::fixed << "gather: " << gatherTime - mulpTime << "s" << std::endl;
+        if (options.repeat > 1) {
+            std::cerr << std::fixed << "runs: " << runTimes.size() << " min " << stats::percentile(runTimes, 0.0)
+                      << "s median " << stats::percentile(runTimes, 0.5) << "s p95 "
+                      << stats::percentile(runTimes, 0.95) << "s" << std::endl;
+        }
+        std::cerr << std::fixed << "plan: " << (plan.useDense ? "dense" : "sparse") << " (estimated cost sparse "
+                  << plan.sparseCost << " dense " << plan.denseCost << ")" << std::endl;
+        for (const std::string& placement : placements) {
+            std::cerr << "placement: " << placement << std::endl;
+        }
     }
 
     MPI_Finalize();
@@ -1,5 +1,6 @@
 #include <mpi.h>
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <iomanip>
@@ -10,8 +11,10 @@
 #include "../densematgen.h"
 #include "common.h"
 #include "context.h"
+#include "decompression.h"
 #include "matrix.h"
 #include "mpi_helpers.h"
+#include "stats.h"
 
 std::ostream& operator<<(std::ostream& os, const MatrixIndex& mIdx) {
     os << "("
@@ -21,7 +24,9 @@ std::ostream& operator<<(std::ostream& os, const MatrixIndex& mIdx) {
 }
 
 SparseMatrix SparseMatrix::fromFile(std::string& otherFileName) {
-    std::ifstream otherFile(otherFileName);
+    stats::PhaseScope phase(stats::Phase::Parse);
+    std::unique_ptr<std::istream> otherFilePtr = openInputStream(otherFileName);
+    std::istream& otherFile = *otherFilePtr;
 
     int rows, columns, nonZerosCount, nonZerosPerRow;
 
@@ -43,10 +48,133 @@ SparseMatrix SparseMatrix::fromFile(std::string& otherFileName) {
         otherFile >> colIdx[i];
     }
 
-    otherFile.close();
     return SparseMatrix({rows, columns}, nonZeros, rowIdx, colIdx);
 }
 
+MatrixDimension SparseMatrix::readDimension(std::string& fileName) {
+    std::unique_ptr<std::istream> filePtr = openInputStream(fileName);
+    std::istream& file = *filePtr;
+
+    int rows, columns;
+    file >> rows >> columns;
+    assert(rows == columns);
+
+    return {rows, columns};
+}
+
+int SparseMatrix::columnSpan() const {
+    if (this->colIdx.empty()) {
+        return 0;
+    }
+    auto range = std::minmax_element(this->colIdx.begin(), this->colIdx.end());
+    return *range.second - *range.first + 1;
+}
+
+SparseColumns SparseMatrix::toColumns() const {
+    // counting sort of values by column, rows stay ascending within each column
+    std::vector<int> counts(this->dimension.col + 1, 0);
+    for (int c : this->colIdx) {
+        counts[c + 1]++;
+    }
+    for (int c = 0; c < this->dimension.col; c++) {
+        counts[c + 1] += counts[c];
+    }
+
+    SparseColumns result;
+    result.rows.resize(this->values.size());
+    result.values.resize(this->values.size());
+    std::vector<int> next(counts.begin(), counts.end() - 1);
+    for (int r = 0; r < this->dimension.row; r++) {
+        for (int i = this->rowIdx[r]; i < this->rowIdx[r + 1]; i++) {
+            int pos = next[this->colIdx[i]]++;
+            result.rows[pos] = r;
+            result.values[pos] = this->values[i];
+        }
+    }
+
+    for (int c = 0; c < this->dimension.col; c++) {
+        if (counts[c] != counts[c + 1]) {
+            result.columns.push_back(c);
+            result.columnStarts.push_back(counts[c]);
+        }
+    }
+    result.columnStarts.push_back(this->values.size());
+    return result;
+}
+
+// Position of tile (@x, @y) on the Morton (Z-order) curve, by interleaving bits of the coordinates
+uint64_t mortonIndex(uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (int bit = 0; bit < 32; bit++) {
+        index |= (uint64_t)((x >> bit) & 1) << (2 * bit + 1);
+        index |= (uint64_t)((y >> bit) & 1) << (2 * bit);
+    }
+    return index;
+}
+
+// Position of tile (@x, @y) on the Hilbert curve covering a @side x @side grid, @side being a power of two
+uint64_t hilbertIndex(uint32_t side, uint32_t x, uint32_t y) {
+    uint64_t index = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        uint32_t rx = (x & s) > 0;
+        uint32_t ry = (y & s) > 0;
+        index += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // rotate the quadrant, so the curve inside it starts and ends at the right corners
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+SparseTiles SparseMatrix::toTiles(TileOrder order) const {
+    const int T = SparseTiles::TILE_SIZE;
+    uint32_t side = 1;
+    while ((int)side * T < std::max(this->dimension.row, this->dimension.col)) {
+        side *= 2;
+    }
+
+    // curve index of the tile of each value, stable sort keeps row-major order within tiles
+    std::vector<uint64_t> curveIndices(this->values.size());
+    std::vector<int> rowOf(this->values.size());
+    for (int r = 0; r < this->dimension.row; r++) {
+        for (int i = this->rowIdx[r]; i < this->rowIdx[r + 1]; i++) {
+            uint32_t x = r / T, y = this->colIdx[i] / T;
+            curveIndices[i] = order == TileOrder::Hilbert ? hilbertIndex(side, x, y) : mortonIndex(x, y);
+            rowOf[i] = r;
+        }
+    }
+    std::vector<int> permutation(this->values.size());
+    for (int i = 0; i < (int)permutation.size(); i++) {
+        permutation[i] = i;
+    }
+    std::stable_sort(permutation.begin(), permutation.end(),
+                     [&](int a, int b) { return curveIndices[a] < curveIndices[b]; });
+
+    SparseTiles result;
+    result.rows.resize(this->values.size());
+    result.columns.resize(this->values.size());
+    result.values.resize(this->values.size());
+    for (int pos = 0; pos < (int)permutation.size(); pos++) {
+        int i = permutation[pos];
+        int tileRow = rowOf[i] / T * T, tileColumn = this->colIdx[i] / T * T;
+        if (pos == 0 || curveIndices[i] != curveIndices[permutation[pos - 1]]) {
+            result.tileRows.push_back(tileRow);
+            result.tileColumns.push_back(tileColumn);
+            result.tileStarts.push_back(pos);
+        }
+        result.rows[pos] = rowOf[i] - tileRow;
+        result.columns[pos] = this->colIdx[i] - tileColumn;
+        result.values[pos] = this->values[i];
+    }
+    result.tileStarts.push_back(this->values.size());
+    return result;
+}
+
 /* Returns an original other filled with zeros besides provided subother. */
 SparseMatrix SparseMatrix::maskSubMatrix(MatrixFragment& fragment) {
     std::vector<double> newValues;
@@ -194,11 +322,15 @@ void SparseMatrix::printShort() {
 
 void SparseMatrix::join(SparseMatrix&& matrix) {
     SparseMatrix m = std::move(matrix);
+    this->join(m);
+}
+
+void SparseMatrix::join(const SparseMatrix& m) {
     assert(dimension.col == m.dimension.col);
     assert(dimension.row == m.dimension.row);
 
-    SparseMatrix* left = this;
-    SparseMatrix* right = &m;
+    const SparseMatrix* left = this;
+    const SparseMatrix* right = &m;
     std::vector<double> values(left->values.size() + right->values.size());
     std::vector<int> colIdx(left->colIdx.size() + right->colIdx.size());
     std::vector<int> rowIdx(this->dimension.row + 1);
@@ -368,6 +500,35 @@ int DenseMatrix::countGE(MatrixFragment fragment, double geValue) {
     return ret;
 }
 
+DenseMatrix::Sparsity DenseMatrix::sparsity(int colStart, int colEnd) {
+    Sparsity result;
+    result.nonZeroRows.resize(this->dimension.row, false);
+    result.nonZeroColumns.resize(colEnd - colStart, false);
+
+    for (int c = colStart; c < colEnd; c++) {
+        for (int r = 0; r < this->dimension.row; r++) {
+            if ((*this)(r, c) != 0.0) {
+                result.numNonZeroRows += !result.nonZeroRows[r];
+                result.numNonZeroColumns += !result.nonZeroColumns[c - colStart];
+                result.nonZeroRows[r] = result.nonZeroColumns[c - colStart] = true;
+            }
+        }
+    }
+    return result;
+}
+
+DenseMatrix DenseMatrix::generate(int numRows, const std::vector<int>& columns, int seed) {
+    std::vector<double> data((size_t)numRows * columns.size());
+    int idx = 0;
+    for (int c : columns) {
+        for (int r = 0; r < numRows; r++) {
+            data[idx++] = generate_double(seed, r, c);
+        }
+    }
+
+    return DenseMatrix({numRows, (int)columns.size()}, data);
+}
+
 double& DenseMatrix::operator()(int rowIdx, int colIdx) {
     int idx = colIdx * this->dimension.row + rowIdx;
     return this->data[idx];
@@ -4,6 +4,7 @@
 #include <mpi.h>
 
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <memory>
@@ -41,6 +42,31 @@ public:
     virtual ~Matrix() = default;
 };
 
+/* Sparse matrix in CSC format, for column-oriented kernels. Only nonempty columns are stored. */
+struct SparseColumns {
+    std::vector<int> columns;       // indices of nonempty columns, ascending
+    std::vector<int> columnStarts;  // start of each of @columns in @rows and @values, followed by the end
+    std::vector<int> rows;          // ascending within each column
+    std::vector<double> values;
+};
+
+/*
+    Sparse matrix split into square tiles, ordered along a space-filling curve over (row, column) tiles.
+    Nonzero values within a tile are in row-major order, with indices relative to the tile. A kernel walking
+    the tiles reads and writes dense matrices only within windows of the tile size at a time, and moves
+    between the windows along the curve.
+*/
+struct SparseTiles {
+    static const int TILE_SIZE = 512;  // tile offsets fit in 16 bits
+
+    std::vector<int> tileRows;        // first row of each tile
+    std::vector<int> tileColumns;     // first column of each tile
+    std::vector<int> tileStarts;      // start of each tile in @rows, @columns and @values, followed by the end
+    std::vector<uint16_t> rows;       // relative to the tile
+    std::vector<uint16_t> columns;    // relative to the tile
+    std::vector<double> values;
+};
+
 class SparseMatrix : public Matrix {
 public:
     SparseMatrix() = default;
@@ -52,17 +78,32 @@ public:
     SparseMatrix& operator=(const SparseMatrix& other) = delete;
     SparseMatrix& operator=(SparseMatrix&& other) = default;
 
+    /* Parses matrix from text file, which may be gzip- or zstd-compressed (decompressed on the fly). */
     static SparseMatrix fromFile(std::string& otherFileName);
 
+    /* Reads only the header of the matrix file, so the dimension is known before the whole file is parsed. */
+    static MatrixDimension readDimension(std::string& fileName);
+
     /* Returns an original other filled with zeros besides provided subother. */
     SparseMatrix maskSubMatrix(MatrixFragment& fragment);
 
     void join(SparseMatrix&& matrix);
+    void join(const SparseMatrix& matrix);
 
     void print(int verbosity) override;
 
     static SparseMatrix blank(MatrixDimension dimension);
 
+    int nonZeros() const { return this->values.size(); }
+
+    /* Number of columns between the first and the last nonempty one, inclusive, 0 if matrix is zero. */
+    int columnSpan() const;
+
+    SparseColumns toColumns() const;
+
+    /* @order is either Morton or Hilbert. */
+    SparseTiles toTiles(TileOrder order) const;
+
     typedef double FieldValue;
     typedef std::tuple<MatrixIndex, FieldValue> Field;
 
@@ -133,10 +174,26 @@ public:
 
     int countGE(MatrixFragment fragment, double geValue);
 
+    /* Rows and columns holding nonzero values within a range of columns of the matrix. */
+    struct Sparsity {
+        std::vector<char> nonZeroRows;     // whether row has a nonzero value, for each row
+        std::vector<char> nonZeroColumns;  // whether column has a nonzero value, for each column of the range
+        int numNonZeroRows = 0;
+        int numNonZeroColumns = 0;
+
+        bool isZero() const { return numNonZeroColumns == 0; }
+        double rowDensity() const { return nonZeroRows.empty() ? 0.0 : (double)numNonZeroRows / nonZeroRows.size(); }
+    };
+
+    Sparsity sparsity(int colStart, int colEnd);
+
     static DenseMatrix blank(MatrixDimension dimension);
 
     static DenseMatrix generate(MatrixFragment& fragment, int seed);
 
+    /* Generates only the given @columns, of @numRows rows each. */
+    static DenseMatrix generate(int numRows, const std::vector<int>& columns, int seed);
+
     friend PackedData pack<DenseMatrix>(DenseMatrix& matrix, MPI_Comm comm);
     friend DenseMatrix unpack<DenseMatrix>(char* buf, int size, MPI_Comm comm);
 
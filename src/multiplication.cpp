@@ -1,35 +1,216 @@
 #include <mpi.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <memory>
 
 #include "common.h"
 #include "context.h"
+#include "fragment_store.h"
+#include "heartbeat.h"
 #include "matrix.h"
 #include "multiplication.h"
 #include "mpi_helpers.h"
+#include "stats.h"
+#include "task_graph.h"
+#include "utils.h"
 
-// Perform C += A * B, C does not have to be blank (zeroes)
-void matrixMultiply(SparseMatrix& A, DenseMatrix& B, DenseMatrix& C) {
-    for (int c = 0; c < B.dimension.col; c++) {
-        for (auto fieldA : A) {
-            MatrixIndex idxA;
-            double valueA;
-            std::tie(idxA, valueA) = fieldA;
+// Number of column panels dense matrices are split into, each panel is multiplied and reduced separately
+const int NUM_COLUMN_PANELS = 4;
 
-            C(idxA.row, c) += valueA * B(idxA.col, c);
+// Fraction of nonzero rows of dense matrix panel, below which the panel is multiplied in sparse form
+const double SPARSE_PANEL_DENSITY = 0.5;
+
+// Fraction of columns of the matrix, which fragments spanning at most that many columns are multiplied in
+// CSC format, e.g. fragments of ColumnA with more than one replication group
+const double NARROW_FRAGMENT_SPAN = 0.5;
+
+bool isNarrow(const SparseMatrix& A) { return A.columnSpan() <= NARROW_FRAGMENT_SPAN * A.dimension.col; }
+
+/*
+    Perform C += A * B on columns [colStart, colEnd), C does not have to be blank (zeroes).
+    @sparsityB describes B within those columns, zero columns of B are skipped and, when B is sparse enough,
+    so are nonzero values of A landing on zero rows of B.
+    If @columnsA (A in CSC format) is given, a narrow A is multiplied column by column: only the rows of B
+    matching A's few nonempty columns are read, each value once, while their products are scattered to C.
+    If @tilesA (A in tiled format) is given, A is multiplied tile by tile: each column of B and C is accessed
+    only within the tile's window of rows at a time.
+*/
+void matrixMultiply(SparseMatrix& A, const SparseColumns* columnsA, const SparseTiles* tilesA, DenseMatrix& B,
+                    DenseMatrix& C, int colStart, int colEnd, const DenseMatrix::Sparsity& sparsityB) {
+    stats::PhaseScope phase(stats::Phase::Kernel);
+    if (sparsityB.isZero()) {
+        stats::add(stats::Counter::SkippedPanelKernels, 1);
+        return;
+    }
+
+    if (tilesA != nullptr) {
+        stats::add(stats::Counter::TiledPanelKernels, 1);
+        for (int t = 0; t < (int)tilesA->tileStarts.size() - 1; t++) {
+            for (int c = colStart; c < colEnd; c++) {
+                if (!sparsityB.nonZeroColumns[c - colStart]) {
+                    continue;
+                }
+                const double* windowB = &B(tilesA->tileColumns[t], c);
+                double* windowC = &C(tilesA->tileRows[t], c);
+                for (int i = tilesA->tileStarts[t]; i < tilesA->tileStarts[t + 1]; i++) {
+                    windowC[tilesA->rows[i]] += tilesA->values[i] * windowB[tilesA->columns[i]];
+                }
+            }
+        }
+        return;
+    }
+
+    if (columnsA != nullptr) {
+        stats::add(stats::Counter::ColumnPanelKernels, 1);
+        for (int c = colStart; c < colEnd; c++) {
+            if (!sparsityB.nonZeroColumns[c - colStart]) {
+                continue;
+            }
+            const double* columnB = &B(0, c);
+            double* columnC = &C(0, c);
+            for (int t = 0; t < (int)columnsA->columns.size(); t++) {
+                double valueB = columnB[columnsA->columns[t]];
+                if (valueB == 0.0) {
+                    continue;
+                }
+                for (int i = columnsA->columnStarts[t]; i < columnsA->columnStarts[t + 1]; i++) {
+                    columnC[columnsA->rows[i]] += columnsA->values[i] * valueB;
+                }
+            }
+        }
+        return;
+    }
+
+    if (sparsityB.rowDensity() >= SPARSE_PANEL_DENSITY) {
+        stats::add(stats::Counter::DensePanelKernels, 1);
+        for (int c = colStart; c < colEnd; c++) {
+            if (!sparsityB.nonZeroColumns[c - colStart]) {
+                continue;
+            }
+            for (auto fieldA : A) {
+                MatrixIndex idxA;
+                double valueA;
+                std::tie(idxA, valueA) = fieldA;
+
+                C(idxA.row, c) += valueA * B(idxA.col, c);
+            }
+        }
+        return;
+    }
+
+    // Sparse form, only nonzero values of A meeting nonzero rows of B take part in the multiplication
+    stats::add(stats::Counter::SparsePanelKernels, 1);
+    std::vector<int> rows, cols;
+    std::vector<double> values;
+    for (auto fieldA : A) {
+        MatrixIndex idxA;
+        double valueA;
+        std::tie(idxA, valueA) = fieldA;
+
+        if (sparsityB.nonZeroRows[idxA.col]) {
+            rows.push_back(idxA.row);
+            cols.push_back(idxA.col);
+            values.push_back(valueA);
+        }
+    }
+
+    for (int c = colStart; c < colEnd; c++) {
+        if (!sparsityB.nonZeroColumns[c - colStart]) {
+            continue;
+        }
+        for (int i = 0; i < (int)values.size(); i++) {
+            C(rows[i], c) += values[i] * B(cols[i], c);
         }
     }
 }
 
-DenseMatrix multiply(Context& ctx, SparseMatrix&& inA, DenseMatrix&& inB, int exponent) {
-    SparseMatrix matA = std::move(inA);
-    DenseMatrix matB = std::move(inB);
-    DenseMatrix matC;
-    MPI_Request sendReq, recvReq;
-    PackedData sendData, recvData;
-    int sendSize;
-    std::vector<int> recvSizeCache(ctx.numReplicationGroups, -1);
-    int matFragIdx = 0;
+// Minimal size (in bytes) of sparse matrix transfer, for it to be split into stripes
+const int MIN_STRIPED_TRANSFER_SIZE = 1 << 16;
+
+/*
+    Broadcasts packed @data of @size bytes over inter communicator. Large transfers are split into stripes
+    broadcasted concurrently, each over its own duplicate of the inter communicator (@stripeComms), so that
+    they may progress independently e.g. through different network rails.
+*/
+void stripedIbcast(char* data, int size, int root, std::vector<MPI_Comm>& stripeComms,
+                   std::vector<MPI_Request>& reqs) {
+    int numStripes = size >= MIN_STRIPED_TRANSFER_SIZE ? stripeComms.size() : 1;
+    for (int s = 0; s < numStripes; s++) {
+        MPI_Request req;
+        int stripeStart = utils::getFairPartBeginning(s, size, numStripes);
+        int stripeEnd = utils::getFairPartBeginning(s + 1, size, numStripes);
+        MPI_Ibcast(data + stripeStart, stripeEnd - stripeStart, MPI_PACKED, root, stripeComms[s], &req);
+        reqs.push_back(req);
+    }
+}
+
+/*
+    Sends @sendData (empty for non-leaders) to all destinations of the ring topology and receives
+    @recvData from its source. Transfers are split into stripes the same way as by stripedIbcast, but every
+    process posts an operation on each stripe communicator (empty ones when not split), since neighborhood
+    collectives are collective over the whole communicator.
+*/
+void stripedNeighborAllgatherv(char* sendData, int sendSize, char* recvData, int recvSize,
+                               std::vector<MPI_Comm>& stripeComms, std::vector<MPI_Request>& reqs) {
+    int numSendStripes = sendSize >= MIN_STRIPED_TRANSFER_SIZE ? stripeComms.size() : 1;
+    int numRecvStripes = recvSize >= MIN_STRIPED_TRANSFER_SIZE ? stripeComms.size() : 1;
+    for (int s = 0; s < (int)stripeComms.size(); s++) {
+        MPI_Request req;
+        int sendStart = utils::getFairPartBeginning(std::min(s, numSendStripes), sendSize, numSendStripes);
+        int sendEnd = utils::getFairPartBeginning(std::min(s + 1, numSendStripes), sendSize, numSendStripes);
+        int recvStart = utils::getFairPartBeginning(std::min(s, numRecvStripes), recvSize, numRecvStripes);
+        int recvEnd = utils::getFairPartBeginning(std::min(s + 1, numRecvStripes), recvSize, numRecvStripes);
+        int recvCount = recvEnd - recvStart;
+        int displacement = 0;
+        MPI_Ineighbor_allgatherv(sendData + sendStart, sendEnd - sendStart, MPI_PACKED, recvData + recvStart,
+                                 &recvCount, &displacement, MPI_PACKED, stripeComms[s], &req);
+        reqs.push_back(req);
+    }
+}
+
+/*
+    Multiplication is expressed as a graph of tasks executed by TaskGraph:
+        - transfers of sparse matrix fragments through the ring of replication groups: exchange of packed
+          data size, receive from the successor and forward of the held fragment to the predecessor (by leader),
+        - unpacking and releasing of received fragments,
+        - kernels multiplying a fragment by a single column panel of dense matrix,
+        - reductions of result's column panels within dense matrix replication group,
+        - clearing of column panels of the previous exponent's dense matrix, reused for the next result,
+        - sparsity analyses of dense matrix panels and checks whether dense matrix became zero on all processes.
+    Kernels of the next exponent on a column panel wait only for reduction of that panel, thus reductions
+    overlap with computation, same as transfers of the following fragments do. At most one fragment is
+    received ahead of the one being multiplied.
+
+    Zero panels of B are neither multiplied nor reduced (result's panel is zero on every replication group
+    member). Once B of some exponent is zero on all processes, e.g. for nilpotent A, the rest of the result is
+    zero as well, thus tasks of the following exponents are skipped. Whether to skip is decided by the result
+    of a reduction over all processes, so all processes skip the same collectives.
+
+    Kernels, clearing and analyses are compute tasks, with --offload they run on a compute thread, while
+    the main thread is left to post and progress transfers and reductions, so they proceed during kernels.
+
+    With the neighborhood transport, send and receive of a transfer are a single neighborhood collective over
+    the ring topology, posted by all processes in the same order.
+
+    With a network model, tasks receiving data are delayed until the data would arrive over the modeled
+    network (only the receiving side is modeled, sent data is released as soon as MPI completes the send).
+
+    With --heartbeat, every process reports each finished shift by a reduction to the main leader, whose
+    Heartbeat writes the progress (shifts of skipped exponents count as finished).
+
+    Either the initial fragment is being assembled (@assemblyA) or unpacked from a retained copy (@packedA)
+    and the following ones are passed through the ring, or all of them are read asynchronously from
+    node-local scratch (@store), in place of the transfers.
+*/
+DenseMatrix multiply(Context& ctx, utils::SparseMatrixAssembly* assemblyA, const PackedData* packedA,
+                     FragmentStore* store, DenseMatrix&& inB, int exponent) {
+    typedef TaskGraph::TaskId TaskId;
+    const TaskId NO_TASK = TaskGraph::NO_TASK;
+
+    SparseMatrix remainderA;  // part of the initial fragment, which was not multiplied by the local part kernels
+    assert((assemblyA != nullptr && assemblyA->isPending()) + (packedA != nullptr) + (store != nullptr) == 1);
 
     int numShifts;
     switch (ctx.algorithm) {
@@ -43,71 +224,472 @@ DenseMatrix multiply(Context& ctx, SparseMatrix&& inA, DenseMatrix&& inB, int ex
             throw "should not happen";
     }
 
+    int numTransfers = exponent * (numShifts - 1);
+    int numFragments = numTransfers + 1;  // fragment k is the one held after k transfers
+
+    std::vector<SparseMatrix> fragments(numFragments);
+    std::vector<PackedData> packedFragments(numFragments);
+    std::vector<int> recvSizeCache(ctx.numReplicationGroups, -1);
+    std::vector<int> sendSizeCache(ctx.numReplicationGroups, -1);
+
+    // Dense matrix B of exponent e is stored in buffers[(e - 1) % 2], and its result C in buffers[e % 2]
+    MatrixDimension denseDimension = inB.dimension;
+    DenseMatrix buffers[2] = {std::move(inB), DenseMatrix::blank(denseDimension)};
+
+    int numPanels = std::max(1, std::min(denseDimension.col, NUM_COLUMN_PANELS));
+    std::vector<int> panelStarts(numPanels + 1);
+    for (int q = 0; q <= numPanels; q++) {
+        panelStarts[q] = utils::getFairPartBeginning(q, denseDimension.col, numPanels);
+    }
+
     int isRGLeader = ctx.process.sparseRG.isLeader(ctx.process.id);
-    if (isRGLeader) {
-        sendData = pack<SparseMatrix>(matA, ctx.process.sparseRG.predInterComm);
+    MPI_Comm predComm = ctx.process.sparseRG.predInterComm;
+    MPI_Comm succComm = ctx.process.sparseRG.succInterComm;
+
+    TaskGraph graph(
+        ctx.offload, [&ctx]() { ctx.placement.pinThread(Placement::COMPUTE_THREAD); },
+        ctx.netModel.isEnabled() ? &ctx.netModel : nullptr);
+    std::vector<TaskId> fragmentReady(numFragments, NO_TASK);  // fragment is unpacked
+    std::vector<TaskId> packedReady(numFragments, NO_TASK);    // packed fragment is available for forwarding
+    std::vector<TaskId> released(numFragments, NO_TASK);       // fragment is no longer needed
+    std::vector<std::vector<TaskId>> fragmentUsers(numFragments);
+    std::vector<TaskId> sent(numTransfers, NO_TASK);
+    std::vector<TaskId> received(numTransfers, NO_TASK);
+    std::vector<TaskId> reduced(numPanels, NO_TASK);  // reduction of the panel in the previous exponent
+    std::vector<TaskId> cleared(numPanels, NO_TASK);  // clearing of the panel for the current exponent
+    TaskId lastReduced = NO_TASK;
+
+    // Sparsity of the dense matrix panels, for each of the buffers
+    std::vector<DenseMatrix::Sparsity> sparsity[2] = {std::vector<DenseMatrix::Sparsity>(numPanels),
+                                                      std::vector<DenseMatrix::Sparsity>(numPanels)};
+    std::vector<TaskId> analyzed(numPanels, NO_TASK);  // analysis of the panel of the current exponent's B
+
+    // B of exponent zeroSince and of all the following exponents is zero on all processes
+    // (written by the main thread, while compute tasks read it; checks finished after a task became ready never
+    // lower it down to the task's exponent, so the task's decision does not depend on the timing)
+    std::atomic<int> zeroSince(exponent + 1);
+    std::vector<int> localNonZero(exponent + 1), globalNonZero(exponent + 1);
+    std::vector<TaskId> zeroChecked(exponent + 1, NO_TASK);  // check of B of exponent e + 1, gates exponent e + 2
+    TaskId lastZeroChecked = NO_TASK;
+
+    // Adds task of exponent @e, which is skipped once B of an earlier exponent turns out to be zero
+    auto addExponentTask = [&](int e, TaskGraph::Action action, std::vector<TaskId> dependencies) {
+        dependencies.push_back(e >= 2 ? zeroChecked[e - 2] : NO_TASK);
+        return graph.add(
+            [&zeroSince, e, action](std::vector<MPI_Request>& reqs) {
+                if (e <= zeroSince) {
+                    action(reqs);
+                }
+            },
+            dependencies);
+    };
+
+    // Adds compute task of exponent @e, which is skipped the same way
+    auto addExponentCompute = [&](int e, TaskGraph::ComputeAction action, std::vector<TaskId> dependencies) {
+        dependencies.push_back(e >= 2 ? zeroChecked[e - 2] : NO_TASK);
+        return graph.addCompute(
+            [&zeroSince, e, action]() {
+                if (e <= zeroSince) {
+                    action();
+                }
+            },
+            dependencies);
+    };
+
+    // Narrow fragments are converted to CSC format, and with --tiles the other ones to tiled format, by a compute
+    // task before their first kernel, the last slot is for the remainder of the initial fragment
+    std::vector<SparseColumns> fragmentColumns(numFragments + 1);
+    std::vector<SparseTiles> fragmentTiles(numFragments + 1);
+    std::vector<char> isColumnar(numFragments + 1, false);
+    std::vector<char> isTiled(numFragments + 1, false);
+    std::vector<TaskId> converted(numFragments + 1, NO_TASK);
+    auto addConversion = [&](int e, int slot, SparseMatrix* matrix, TaskId ready) {
+        if (converted[slot] == NO_TASK) {
+            converted[slot] = addExponentCompute(
+                e,
+                [&, slot, matrix]() {
+                    isColumnar[slot] = isNarrow(*matrix);
+                    isTiled[slot] = !isColumnar[slot] && ctx.tileOrder != TileOrder::None;
+                    if (isColumnar[slot]) {
+                        fragmentColumns[slot] = matrix->toColumns();
+                    } else if (isTiled[slot]) {
+                        fragmentTiles[slot] = matrix->toTiles(ctx.tileOrder);
+                    }
+                },
+                {ready});
+        }
+        return converted[slot];
+    };
+
+    // Adds asynchronous read of fragment @k from the store, unpacked as if received, as tasks of exponent @e
+    auto addFragmentRead = [&](int e, int k, std::vector<TaskId> dependencies) {
+        dependencies.push_back(e >= 2 ? zeroChecked[e - 2] : NO_TASK);
+        TaskId read = graph.addAsync(
+            [&, e, k]() {
+                if (e > zeroSince) {
+                    std::promise<void> skipped;
+                    skipped.set_value();
+                    return skipped.get_future();
+                }
+                return store->prefetch((ctx.process.sparseRG.id + k) % ctx.numReplicationGroups,
+                                       packedFragments[k]);
+            },
+            dependencies);
+        return addExponentTask(
+            e,
+            [&, k](std::vector<MPI_Request>&) {
+                stats::PhaseScope phase(stats::Phase::Unpack);
+                fragments[k] = unpack<SparseMatrix>(packedFragments[k], ctx.process.sparseRG.internalComm);
+                packedFragments[k] = PackedData();
+            },
+            {read});
+    };
+
+    // Checks whether B of exponent @e + 1 is zero on all processes
+    auto addZeroCheck = [&](int e) {
+        std::vector<TaskId> checkDependencies = analyzed;
+        checkDependencies.push_back(lastZeroChecked);
+        TaskId check = addExponentTask(
+            e,
+            [&, e](std::vector<MPI_Request>& reqs) {
+                MPI_Request req;
+                localNonZero[e] = false;
+                for (auto& panelSparsity : sparsity[e % 2]) {
+                    localNonZero[e] |= !panelSparsity.isZero();
+                }
+                MPI_Iallreduce(&localNonZero[e], &globalNonZero[e], 1, MPI_INT, MPI_LOR, ctx.globalComm, &req);
+                reqs.push_back(req);
+                stats::add(stats::Counter::WorldBytes, sizeof(int));
+                graph.delayCompletion(NetRole::World, sizeof(int));
+            },
+            checkDependencies);
+        zeroChecked[e] = lastZeroChecked = graph.add(
+            [&, e](std::vector<MPI_Request>&) {
+                if (!globalNonZero[e]) {
+                    zeroSince = std::min(zeroSince.load(), e + 1);
+                }
+            },
+            {check});
+    };
+
+    // Progress reports are reductions on a separate communicator, so they are not ordered with the other collectives
+    std::unique_ptr<Heartbeat> heartbeat;
+    MPI_Comm heartbeatComm = MPI_COMM_NULL;
+    std::vector<int> shiftDone(exponent * numShifts, 1), shiftDoneEverywhere(exponent * numShifts);
+    TaskId lastReported = NO_TASK;
+    if (ctx.heartbeatInterval > 0) {
+        MPI_Comm_dup(ctx.globalComm, &heartbeatComm);
+        if (ctx.process.isMainLeader()) {
+            heartbeat.reset(new Heartbeat(ctx.heartbeatInterval, ctx.heartbeatFile, exponent, numShifts));
+        }
+    }
+
+    // Reports that shift @i of exponent @e is done, once @dependencies are
+    auto addShiftReport = [&](int e, int i, std::vector<TaskId> dependencies) {
+        int s = (e - 1) * numShifts + (i - 1);
+        // own time of the main leader is not held back by the reductions of the previous shifts
+        TaskId stamped = NO_TASK;
+        if (heartbeat) {
+            stamped = graph.add([&, e, i](std::vector<MPI_Request>&) { heartbeat->shiftDone(e, i); }, dependencies);
+        }
+        dependencies.push_back(lastReported);
+        TaskId reported = lastReported = graph.add(
+            [&, s](std::vector<MPI_Request>& reqs) {
+                MPI_Request req;
+                MPI_Ireduce(&shiftDone[s], &shiftDoneEverywhere[s], 1, MPI_INT, MPI_MIN, MAIN_LEADER_ID,
+                            heartbeatComm, &req);
+                reqs.push_back(req);
+                graph.delayCompletion(NetRole::World, sizeof(int));
+            },
+            dependencies);
+        if (heartbeat) {
+            graph.add([&, e, i](std::vector<MPI_Request>&) { heartbeat->shiftDoneEverywhere(e, i); },
+                      {stamped, reported});
+        }
+    };
+
+    for (int q = 0; q < numPanels; q++) {
+        analyzed[q] = graph.addCompute([&, q]() {
+            sparsity[0][q] = buffers[0].sparsity(panelStarts[q], panelStarts[q + 1]);
+        });
+    }
+    if (exponent >= 2) {
+        addZeroCheck(0);
+    }
+
+    if (store) {
+        fragmentReady[0] = addFragmentRead(1, 0, {});
+    } else if (packedA) {
+        fragmentReady[0] = packedReady[0] = graph.add([&](std::vector<MPI_Request>&) {
+            {
+                stats::PhaseScope phase(stats::Phase::Unpack);
+                // unpacking only reads the data
+                fragments[0] = unpack<SparseMatrix>(const_cast<char*>(packedA->data()), packedA->size(),
+                                                    ctx.process.sparseRG.internalComm);
+            }
+            stats::setFragmentNonZeros(fragments[0].nonZeros());
+            if (isRGLeader) {
+                stats::PhaseScope phase(stats::Phase::Pack);
+                packedFragments[0] = pack<SparseMatrix>(fragments[0], predComm);
+            }
+        });
+    } else {
+        // Start with the part of the fragment scattered to the process, while the rest of the replication
+        // group's fragment is still being gathered.
+        TaskId gathered =
+            graph.add([&](std::vector<MPI_Request>& reqs) { reqs.push_back(assemblyA->detachRequest()); });
+        std::vector<TaskId> localKernels;
+        for (int q = 0; q < numPanels; q++) {
+            localKernels.push_back(graph.addCompute(
+                [&, q]() {
+                    matrixMultiply(assemblyA->local, nullptr, nullptr, buffers[0], buffers[1], panelStarts[q],
+                                   panelStarts[q + 1], sparsity[0][q]);
+                },
+                {analyzed[q]}));
+        }
+        std::vector<TaskId> joinDependencies = localKernels;
+        joinDependencies.push_back(gathered);
+        fragmentReady[0] = packedReady[0] = graph.add(
+            [&](std::vector<MPI_Request>&) {
+                remainderA = assemblyA->complete();
+                fragments[0] = std::move(assemblyA->local);
+                fragments[0].join(remainderA);
+                stats::setFragmentNonZeros(fragments[0].nonZeros());
+                if (isRGLeader) {
+                    stats::PhaseScope phase(stats::Phase::Pack);
+                    packedFragments[0] = pack<SparseMatrix>(fragments[0], predComm);
+                }
+            },
+            joinDependencies);
     }
 
     for (int e = 1; e <= exponent; e++) {
-        matC = DenseMatrix::blank(matB.dimension);
+        DenseMatrix* matB = &buffers[(e - 1) % 2];
+        DenseMatrix* matC = &buffers[e % 2];
+        std::vector<std::vector<TaskId>> panelKernels(numPanels);
 
         for (int i = 1; i <= numShifts; i++) {
-            if (i != numShifts) {
+            int k = (e - 1) * (numShifts - 1) + (i - 1);  // fragment multiplied within the shift
+            std::vector<TaskId> shiftKernels;
+
+            if (i != numShifts && store) {
+                // fragment read ahead replaces the transfer, within the same memory bounds
+                fragmentReady[k + 1] = addFragmentRead(e, k + 1, {k > 0 ? released[k - 1] : NO_TASK});
+            } else if (i != numShifts && ctx.transport == Transport::Neighborhood) {
+                // Transfer j brings fragment j + 1 from the successor, and forwards fragment j to the predecessor
+                int j = k;
+                TaskId prevExchanged = j > 0 ? received[j - 1] : NO_TASK;
+                TaskId window = j > 0 ? released[j - 1] : NO_TASK;
+                TaskId forwarded = isRGLeader ? packedReady[j] : NO_TASK;
+                int cacheIdx = j % ctx.numReplicationGroups;
+
+                // receive sizes are cached the same way as with the inter communicator transport
+                if (j < ctx.numReplicationGroups) {
+                    prevExchanged = addExponentTask(
+                        e,
+                        [&, j, cacheIdx](std::vector<MPI_Request>& reqs) {
+                            MPI_Request req;
+                            sendSizeCache[cacheIdx] = packedFragments[j].size();
+                            MPI_Ineighbor_allgather(&sendSizeCache[cacheIdx], 1, MPI_INT, &recvSizeCache[cacheIdx], 1,
+                                                    MPI_INT, ctx.process.sparseRG.ringComms[0], &req);
+                            reqs.push_back(req);
+                            graph.delayCompletion(NetRole::Ring, sizeof(int));
+                        },
+                        {prevExchanged, forwarded, window});
+                }
+
+                sent[j] = received[j] = addExponentTask(
+                    e,
+                    [&, j, cacheIdx](std::vector<MPI_Request>& reqs) {
+                        PackedData& recvData = packedFragments[j + 1];
+                        recvData.resize(recvSizeCache[cacheIdx]);
+                        stripedNeighborAllgatherv(packedFragments[j].data(), packedFragments[j].size(),
+                                                  recvData.data(), recvData.size(), ctx.process.sparseRG.ringComms,
+                                                  reqs);
+                        stats::add(stats::Counter::RingBytes, packedFragments[j].size() + recvData.size());
+                        graph.delayCompletion(NetRole::Ring, recvData.size());
+                    },
+                    {prevExchanged, forwarded, window});
+                packedReady[j + 1] = received[j];
+            } else if (i != numShifts) {
+                // Transfer j brings fragment j + 1 from the successor, and forwards fragment j to the predecessor
+                int j = k;
+                TaskId prevSent = j > 0 ? sent[j - 1] : NO_TASK;
+                TaskId prevReceived = j > 0 ? received[j - 1] : NO_TASK;
+                TaskId window = j > 0 ? released[j - 1] : NO_TASK;
+                int cacheIdx = j % ctx.numReplicationGroups;
+
                 // Processes are unaware about size of packed data they will receive, thus it need
                 // to be sent (broadcasted) to them.
                 // But over time matrix fragments received by the processes will duplicate, as processes
                 // loops through entire sparse matrix in the span of the multiplication. Thus, we can
                 // cache those expected receive sizes.
-                if (recvSizeCache[matFragIdx] == -1) {
+                if (j < ctx.numReplicationGroups) {
                     if (isRGLeader) {
-                        sendSize = sendData.size();
-                        MPI_Ibcast(&sendSize, 1, MPI_INT, MPI_ROOT, ctx.process.sparseRG.predInterComm, &sendReq);
-                    }
-                    MPI_Ibcast(&recvSizeCache[matFragIdx], 1, MPI_INT, INTERNAL_LEADER_ID,
-                               ctx.process.sparseRG.succInterComm, &recvReq);
-
-                    MPI_Wait(&recvReq, MPI_STATUS_IGNORE);
-                    if (isRGLeader) {
-                        MPI_Wait(&sendReq, MPI_STATUS_IGNORE);
+                        prevSent = addExponentTask(
+                            e,
+                            [&, j, cacheIdx](std::vector<MPI_Request>& reqs) {
+                                MPI_Request req;
+                                sendSizeCache[cacheIdx] = packedFragments[j].size();
+                                MPI_Ibcast(&sendSizeCache[cacheIdx], 1, MPI_INT, MPI_ROOT, predComm, &req);
+                                reqs.push_back(req);
+                            },
+                            {prevSent, packedReady[j]});
                     }
+                    prevReceived = addExponentTask(
+                        e,
+                        [&, cacheIdx](std::vector<MPI_Request>& reqs) {
+                            MPI_Request req;
+                            MPI_Ibcast(&recvSizeCache[cacheIdx], 1, MPI_INT, INTERNAL_LEADER_ID, succComm, &req);
+                            reqs.push_back(req);
+                            graph.delayCompletion(NetRole::Ring, sizeof(int));
+                        },
+                        {prevReceived, window});
                 }
 
                 if (isRGLeader) {
-                    MPI_Ibcast(sendData.data(), sendData.size(), MPI_PACKED, MPI_ROOT,
-                               ctx.process.sparseRG.predInterComm, &sendReq);
+                    sent[j] = addExponentTask(
+                        e,
+                        [&, j](std::vector<MPI_Request>& reqs) {
+                            stripedIbcast(packedFragments[j].data(), packedFragments[j].size(), MPI_ROOT,
+                                          ctx.process.sparseRG.predStripeComms, reqs);
+                            stats::add(stats::Counter::RingBytes, packedFragments[j].size());
+                        },
+                        {prevSent, packedReady[j]});
                 }
-                recvData.resize(recvSizeCache[matFragIdx]);
-                MPI_Ibcast(recvData.data(), recvData.size(), MPI_PACKED, INTERNAL_LEADER_ID,
-                           ctx.process.sparseRG.succInterComm, &recvReq);
-                matFragIdx = (matFragIdx + 1) % ctx.numReplicationGroups;
+                received[j] = addExponentTask(
+                    e,
+                    [&, j, cacheIdx](std::vector<MPI_Request>& reqs) {
+                        PackedData& recvData = packedFragments[j + 1];
+                        recvData.resize(recvSizeCache[cacheIdx]);
+                        stripedIbcast(recvData.data(), recvData.size(), INTERNAL_LEADER_ID,
+                                      ctx.process.sparseRG.succStripeComms, reqs);
+                        stats::add(stats::Counter::RingBytes, recvData.size());
+                        graph.delayCompletion(NetRole::Ring, recvData.size());
+                    },
+                    {prevReceived, window});
+                packedReady[j + 1] = received[j];
             }
 
-            matrixMultiply(matA, matB, matC);
+            if (i != numShifts && !store) {
+                fragmentReady[k + 1] = addExponentTask(
+                    e,
+                    [&, k](std::vector<MPI_Request>&) {
+                        stats::PhaseScope phase(stats::Phase::Unpack);
+                        fragments[k + 1] = unpack<SparseMatrix>(packedFragments[k + 1], succComm);
+                        if (!isRGLeader) {
+                            packedFragments[k + 1] = PackedData();
+                        }
+                    },
+                    {received[k]});
+            }
 
-            if (i != numShifts) {
-                MPI_Wait(&recvReq, MPI_STATUS_IGNORE);
-                if (isRGLeader) {
-                    MPI_Wait(&sendReq, MPI_STATUS_IGNORE);
-                }
+            // the very first shift multiplies only the part of the fragment left after the local part kernels
+            bool isRemainder = k == 0 && e == 1 && assemblyA;
+            SparseMatrix* shiftA = isRemainder ? &remainderA : &fragments[k];
+            int slot = isRemainder ? numFragments : k;
+            TaskId shiftReady = addConversion(e, slot, shiftA, fragmentReady[k]);
 
-                matA = unpack<SparseMatrix>(recvData, ctx.process.sparseRG.succInterComm);
+            for (int q = 0; q < numPanels; q++) {
+                TaskId kernel = addExponentCompute(
+                    e,
+                    [&, e, q, shiftA, slot, matB, matC]() {
+                        matrixMultiply(*shiftA, isColumnar[slot] ? &fragmentColumns[slot] : nullptr,
+                                       isTiled[slot] ? &fragmentTiles[slot] : nullptr, *matB, *matC, panelStarts[q],
+                                       panelStarts[q + 1], sparsity[(e - 1) % 2][q]);
+                    },
+                    {shiftReady, analyzed[q], cleared[q]});
+                panelKernels[q].push_back(kernel);
+                fragmentUsers[k].push_back(kernel);
+                shiftKernels.push_back(kernel);
+            }
+            if (heartbeatComm != MPI_COMM_NULL) {
+                addShiftReport(e, i, shiftKernels);
+            }
 
-                if (isRGLeader) {
-                    // Reuse PackedData received from predecessor in replication group,
-                    // instead of sending SparseMatrix and performing packing, before
-                    // each send.
-                    sendData = std::move(recvData);
+            // fragment held after the last shift is multiplied again within the first shift of the next exponent
+            if (i != numShifts || e == exponent) {
+                std::vector<TaskId> releaseDependencies = fragmentUsers[k];
+                if (isRGLeader && k < numTransfers && !store) {
+                    releaseDependencies.push_back(sent[k]);
                 }
+                released[k] = graph.add(
+                    [&, k](std::vector<MPI_Request>&) {
+                        fragments[k] = SparseMatrix();
+                        packedFragments[k] = PackedData();
+                        fragmentColumns[k] = SparseColumns();
+                        fragmentTiles[k] = SparseTiles();
+                    },
+                    releaseDependencies);
             }
         }
 
-        if (ctx.process.denseRG.size > 1) {
-            MPI_Allreduce(MPI_IN_PLACE, matC.data.data(), matC.data.size(), MPI_DOUBLE, MPI_SUM,
-                          ctx.process.denseRG.internalComm);
+        for (int q = 0; q < numPanels; q++) {
+            std::vector<TaskId> reduceDependencies = panelKernels[q];
+            reduceDependencies.push_back(lastReduced);
+            reduced[q] = lastReduced = addExponentTask(
+                e,
+                [&, e, q, matC](std::vector<MPI_Request>& reqs) {
+                    // panel of C is zero on all replication group members, when the panel of B is zero
+                    if (ctx.process.denseRG.size > 1 && !sparsity[(e - 1) % 2][q].isZero()) {
+                        stats::PhaseScope phase(stats::Phase::Reduce);
+                        MPI_Request req;
+                        int offset = panelStarts[q] * matC->dimension.row;
+                        int count = (panelStarts[q + 1] - panelStarts[q]) * matC->dimension.row;
+                        MPI_Iallreduce(MPI_IN_PLACE, matC->data.data() + offset, count, MPI_DOUBLE, MPI_SUM,
+                                       ctx.process.denseRG.internalComm, &req);
+                        reqs.push_back(req);
+                        stats::add(stats::Counter::DenseBytes, count * sizeof(double));
+                        graph.delayCompletion(NetRole::Dense, count * sizeof(double));
+                    }
+                },
+                reduceDependencies);
+
+            if (e != exponent) {
+                analyzed[q] = addExponentCompute(
+                    e,
+                    [&, e, q, matC]() {
+                        sparsity[e % 2][q] = matC->sparsity(panelStarts[q], panelStarts[q + 1]);
+                    },
+                    {reduced[q]});
+            }
+
+            // B of the current exponent becomes C of the next one, once all kernels are done with it
+            if (e != exponent) {
+                cleared[q] = graph.addCompute(
+                    [&, q, matB]() {
+                        int offset = panelStarts[q] * matB->dimension.row;
+                        int count = (panelStarts[q + 1] - panelStarts[q]) * matB->dimension.row;
+                        std::fill(matB->data.begin() + offset, matB->data.begin() + offset + count, 0.0);
+                    },
+                    panelKernels[q]);
+            }
         }
 
-        std::swap(matB, matC);
+        if (e <= exponent - 2) {
+            addZeroCheck(e);
+        }
+    }
+
+    graph.run();
+
+    heartbeat.reset();  // writes the final report
+    if (heartbeatComm != MPI_COMM_NULL) {
+        MPI_Comm_free(&heartbeatComm);
     }
 
-    return matB;
+    return std::move(buffers[exponent % 2]);
+}
+
+DenseMatrix multiply(Context& ctx, utils::SparseMatrixAssembly&& inA, DenseMatrix&& inB, int exponent) {
+    utils::SparseMatrixAssembly assemblyA = std::move(inA);
+    return multiply(ctx, &assemblyA, nullptr, nullptr, std::move(inB), exponent);
+}
+
+DenseMatrix multiply(Context& ctx, const PackedData& packedA, DenseMatrix&& inB, int exponent) {
+    return multiply(ctx, nullptr, &packedA, nullptr, std::move(inB), exponent);
+}
+
+DenseMatrix multiply(Context& ctx, FragmentStore& store, DenseMatrix&& inB, int exponent) {
+    return multiply(ctx, nullptr, nullptr, &store, std::move(inB), exponent);
 }
\ No newline at end of file
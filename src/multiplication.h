@@ -4,7 +4,19 @@
 #include "matrix.h"
 #include "common.h"
 #include "context.h"
+#include "fragment_store.h"
+#include "mpi_helpers.h"
+#include "utils.h"
 
-DenseMatrix multiply(Context& ctx, SparseMatrix&& matA, DenseMatrix&& matB, int exponent);
+DenseMatrix multiply(Context& ctx, utils::SparseMatrixAssembly&& matA, DenseMatrix&& matB, int exponent);
+
+/*
+    Multiplication by the whole fragment of sparse matrix of process'es replication group, retained packed
+    (with the replication group internal communicator) by the caller, e.g. to repeat the multiplication.
+*/
+DenseMatrix multiply(Context& ctx, const PackedData& packedA, DenseMatrix&& matB, int exponent);
+
+/* Out-of-core multiplication, sparse matrix fragments are read from @store instead of passed through the ring. */
+DenseMatrix multiply(Context& ctx, FragmentStore& store, DenseMatrix&& matB, int exponent);
 
 #endif /* __MULTIPLICATION_H__ */
\ No newline at end of file
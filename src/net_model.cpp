@@ -0,0 +1,77 @@
+#include <sstream>
+
+#include "net_model.h"
+
+const char* ROLE_NAMES[(int)NetRole::Count] = {"ring", "dense", "world"};
+
+double parseNonNegative(const std::string& value) {
+    size_t parsed = 0;
+    double result;
+    try {
+        result = std::stod(value, &parsed);
+    } catch (const std::exception&) {
+        throw "Malformed network model value";
+    }
+    if (parsed != value.size() || result < 0) {
+        throw "Malformed network model value";
+    }
+    return result;
+}
+
+NetModel NetModel::fromSpec(const std::string& spec) {
+    NetModel model;
+    std::stringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ',')) {
+        size_t equals = entry.find('=');
+        size_t colon = entry.find(':');
+        if (equals == std::string::npos || colon == std::string::npos || colon < equals) {
+            throw "Malformed network model entry";
+        }
+        std::string role = entry.substr(0, equals);
+
+        Link link;
+        link.modeled = true;
+        link.latency = parseNonNegative(entry.substr(equals + 1, colon - equals - 1)) * 1e-6;
+        link.bandwidth = parseNonNegative(entry.substr(colon + 1)) * 1e6;
+
+        bool found = false;
+        for (int r = 0; r < (int)NetRole::Count; r++) {
+            if (role == ROLE_NAMES[r] || role == "all") {
+                model.links[r] = link;
+                found = true;
+            }
+        }
+        if (!found) {
+            throw "Unknown network model role";
+        }
+    }
+    return model;
+}
+
+bool NetModel::isEnabled() const {
+    for (const Link& link : this->links) {
+        if (link.modeled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+double NetModel::transferTime(NetRole role, long long bytes) const {
+    const Link& link = this->links[(int)role];
+    return link.bandwidth > 0 ? bytes / link.bandwidth : 0.0;
+}
+
+double NetModel::latency(NetRole role) const { return this->links[(int)role].latency; }
+
+std::string NetModel::describe() const {
+    std::stringstream ss;
+    for (int r = 0; r < (int)NetRole::Count; r++) {
+        if (this->links[r].modeled) {
+            ss << (ss.tellp() > 0 ? "," : "") << ROLE_NAMES[r] << "=" << this->links[r].latency * 1e6 << ":"
+               << this->links[r].bandwidth / 1e6;
+        }
+    }
+    return ss.str();
+}
@@ -0,0 +1,51 @@
+#ifndef __NET_MODEL_H__
+#define __NET_MODEL_H__
+
+#include <string>
+
+/* Communicators of the multiplication, as links of the modeled network. */
+enum class NetRole {
+    Ring,   // transfers of sparse matrix fragments between replication groups
+    Dense,  // reductions within dense matrix replication groups
+    World,  // collectives over all processes
+    Count
+};
+
+/*
+    Latency and bandwidth of the network, which MPI transfers are slowed down to. Shared memory MPI on a single
+    node makes every transfer nearly free, so whether communication overlaps with computation can be observed
+    only with the delays injected.
+    Each role is a separate link, messages over the same link are serialized.
+*/
+class NetModel {
+public:
+    /* Model with no delays. */
+    NetModel() = default;
+
+    /*
+        Parses comma separated "role=latency_us:bandwidth_MBps" entries, where role is ring, dense, world or all.
+        Zero bandwidth is unlimited. Roles missing in @spec are not delayed.
+    */
+    static NetModel fromSpec(const std::string& spec);
+
+    bool isEnabled() const;
+
+    /* Seconds message of @bytes spends on the link of @role, before the latency. */
+    double transferTime(NetRole role, long long bytes) const;
+
+    /* Seconds message spends travelling over the link of @role, once sent. */
+    double latency(NetRole role) const;
+
+    std::string describe() const;
+
+private:
+    struct Link {
+        bool modeled = false;
+        double latency = 0.0;    // in seconds
+        double bandwidth = 0.0;  // in bytes per second, 0 if unlimited
+    };
+
+    Link links[(int)NetRole::Count];
+};
+
+#endif /* __NET_MODEL_H__ */
@@ -0,0 +1,93 @@
+#include <mpi.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "common.h"
+#include "context.h"
+#include "profiler.h"
+#include "stats.h"
+#include "utils.h"
+
+std::atomic<long long> samples[stats::NUM_PHASE_PATHS];
+
+void onSample(int) { samples[stats::currentPhasePath()].fetch_add(1, std::memory_order_relaxed); }
+
+void setTimer(int intervalMicroseconds) {
+    struct itimerval timer;
+    timer.it_interval.tv_sec = intervalMicroseconds / 1000000;
+    timer.it_interval.tv_usec = intervalMicroseconds % 1000000;
+    timer.it_value = timer.it_interval;
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+        throw "Cannot set profiling timer";
+    }
+}
+
+void profiler::start() {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = onSample;
+    action.sa_flags = SA_RESTART;  // interrupted system calls (e.g. of MPI) are resumed
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, nullptr) != 0) {
+        throw "Cannot install profiling signal handler";
+    }
+    setTimer(PROFILE_INTERVAL_US);
+}
+
+void profiler::stop() { setTimer(0); }
+
+void writeSamples(std::ofstream& file, const std::string& root, const long long* pathSamples) {
+    for (int path = 0; path < stats::NUM_PHASE_PATHS; path++) {
+        if (pathSamples[path] > 0) {
+            std::string name = path == 0 ? "untracked" : stats::phasePathName(path);
+            file << root << name << " " << pathSamples[path] << std::endl;
+        }
+    }
+}
+
+/*
+    Samples of all processes are gathered by the main leader, which sums them up as well, as they are small
+    (a counter per path of phases).
+*/
+void profiler::writeProfile(Context& ctx, const std::string& fileName) {
+    std::vector<long long> local(stats::NUM_PHASE_PATHS);
+    for (int path = 0; path < stats::NUM_PHASE_PATHS; path++) {
+        local[path] = samples[path];
+    }
+
+    std::vector<long long> all;
+    if (ctx.process.isMainLeader()) {
+        all.resize((size_t)stats::NUM_PHASE_PATHS * ctx.numProcesses);
+    }
+    MPI_Gather(local.data(), stats::NUM_PHASE_PATHS, MPI_LONG_LONG, all.data(), stats::NUM_PHASE_PATHS,
+               MPI_LONG_LONG, MAIN_LEADER_ID, ctx.globalComm);
+
+    if (!ctx.process.isMainLeader()) {
+        return;
+    }
+
+    std::vector<long long> total(stats::NUM_PHASE_PATHS);
+    for (int p = 0; p < ctx.numProcesses; p++) {
+        for (int path = 0; path < stats::NUM_PHASE_PATHS; path++) {
+            total[path] += all[(size_t)p * stats::NUM_PHASE_PATHS + path];
+        }
+    }
+
+    std::ofstream totalFile(fileName);
+    if (!totalFile) {
+        utils::abortWithError("Cannot open profile file " + fileName);
+    }
+    std::ofstream ranksFile(fileName + ".ranks");
+    if (!ranksFile) {
+        utils::abortWithError("Cannot open profile file " + fileName + ".ranks");
+    }
+    writeSamples(totalFile, "", total.data());
+    for (int p = 0; p < ctx.numProcesses; p++) {
+        writeSamples(ranksFile, "rank" + std::to_string(p) + ";", all.data() + (size_t)p * stats::NUM_PHASE_PATHS);
+    }
+}
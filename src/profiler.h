@@ -0,0 +1,35 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <string>
+
+class Context;
+
+/*
+    Sampling profiler attributing CPU time of the process to pipeline phases. A SIGPROF timer interrupts
+    the thread consuming CPU time every PROFILE_INTERVAL_US of it, and the sample is counted for the path of
+    phases active on the interrupted thread (see stats::PhaseScope). Time outside any phase is counted as
+    "untracked". Samples are only counted in the signal handler, so the overhead is a few instructions per
+    sample.
+*/
+namespace profiler {
+
+/* Microseconds of CPU time between samples. */
+const int PROFILE_INTERVAL_US = 1000;
+
+/* Starts sampling the process. */
+void start();
+
+/* Stops sampling the process. */
+void stop();
+
+/*
+    Writes samples in the folded stack format of flame graph tools, summed over all processes to @fileName,
+    and of each process, under its own "rank<id>" frame, to @fileName.ranks, by the main leader.
+    Collective over all processes.
+*/
+void writeProfile(Context& ctx, const std::string& fileName);
+
+}  // namespace profiler
+
+#endif /* __PROFILER_H__ */
@@ -64,6 +64,20 @@ ProgramOptions ProgramOptions::fromCommandLine(int argc, char *argv[]) {
     bool printGreaterEqual = false;
     double printGreaterEqualValue;
     bool printStats = false;
+    std::string outOfCoreDir;
+    int numStripes = 1;
+    bool offload = false;
+    std::string transportName = "intercomm";
+    bool pin = false;
+    std::string reportFile;
+    double heartbeatInterval = 0.0;
+    std::string heartbeatFile;
+    std::string netModelSpec;
+    std::string profileFile;
+    int repeat = 1;
+    int sampleColumns = 0;
+    std::string tileOrderName = "none";
+    std::string denseFallbackName = "auto";
 
     const std::map<std::string, OptionBase *> supportedOptions{
         {"-f", new Option<std::string>(REQUIRED, NAMED, "sparse_matrix_file", "", &sparseMatrixFile)},
@@ -74,6 +88,21 @@ ProgramOptions ProgramOptions::fromCommandLine(int argc, char *argv[]) {
         {"-v", new Option<bool>(OPTIONAL, FLAG, "", "", &printMatrix)},
         {"-i", new Option<bool>(OPTIONAL, FLAG, "", "", &useInnerAlgorithm)},
         {"-p", new Option<bool>(OPTIONAL, FLAG, "", "", &printStats)},
+        {"--out-of-core", new Option<std::string>(OPTIONAL, NAMED, "scratch_dir", "", &outOfCoreDir)},
+        {"--stripes", new Option<int>(OPTIONAL, NAMED, "num_stripes", "", &numStripes)},
+        {"--offload", new Option<bool>(OPTIONAL, FLAG, "", "", &offload)},
+        {"--transport", new Option<std::string>(OPTIONAL, NAMED, "intercomm|neighbor", "", &transportName)},
+        {"--pin", new Option<bool>(OPTIONAL, FLAG, "", "", &pin)},
+        {"--report", new Option<std::string>(OPTIONAL, NAMED, "report_file", "", &reportFile)},
+        {"--heartbeat", new Option<double>(OPTIONAL, NAMED, "interval_seconds", "", &heartbeatInterval)},
+        {"--heartbeat-file", new Option<std::string>(OPTIONAL, NAMED, "heartbeat_file", "", &heartbeatFile)},
+        {"--net-model", new Option<std::string>(OPTIONAL, NAMED, "role=latency_us:bandwidth_MBps,...", "",
+                                                &netModelSpec)},
+        {"--profile", new Option<std::string>(OPTIONAL, NAMED, "profile_file", "", &profileFile)},
+        {"--repeat", new Option<int>(OPTIONAL, NAMED, "num_runs", "", &repeat)},
+        {"--sample", new Option<int>(OPTIONAL, NAMED, "num_columns", "", &sampleColumns)},
+        {"--tiles", new Option<std::string>(OPTIONAL, NAMED, "none|morton|hilbert", "", &tileOrderName)},
+        {"--dense-fallback", new Option<std::string>(OPTIONAL, NAMED, "auto|never|always", "", &denseFallbackName)},
     };
 
     std::set<std::string> foundOptions;
@@ -113,9 +142,93 @@ ProgramOptions ProgramOptions::fromCommandLine(int argc, char *argv[]) {
         printGreaterEqual = true;
     }
 
+    Transport transport;
+    if (transportName == "intercomm") {
+        transport = Transport::InterComm;
+    } else if (transportName == "neighbor") {
+        transport = Transport::Neighborhood;
+    } else {
+        std::cout << "Unrecognized transport: " << transportName << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (numStripes < 1) {
+        std::cout << "Invalid number of stripes: " << numStripes << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (foundOptions.find("--heartbeat") != foundOptions.end() && heartbeatInterval <= 0.0) {
+        std::cout << "Invalid heartbeat interval: " << heartbeatInterval << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (repeat < 1) {
+        std::cout << "Invalid number of runs: " << repeat << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    TileOrder tileOrder;
+    if (tileOrderName == "none") {
+        tileOrder = TileOrder::None;
+    } else if (tileOrderName == "morton") {
+        tileOrder = TileOrder::Morton;
+    } else if (tileOrderName == "hilbert") {
+        tileOrder = TileOrder::Hilbert;
+    } else {
+        std::cout << "Unrecognized tile order: " << tileOrderName << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    DenseFallback denseFallback;
+    if (denseFallbackName == "auto") {
+        denseFallback = DenseFallback::Auto;
+    } else if (denseFallbackName == "never") {
+        denseFallback = DenseFallback::Never;
+    } else if (denseFallbackName == "always") {
+        denseFallback = DenseFallback::Always;
+    } else {
+        std::cout << "Unrecognized dense fallback: " << denseFallbackName << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (denseFallback == DenseFallback::Always && !outOfCoreDir.empty()) {
+        std::cout << "Dense fallback keeps the whole matrix in memory, it cannot be forced out-of-core" << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (sampleColumns < 0 || (sampleColumns > 0 && !printGreaterEqual)) {
+        std::cout << "Sampling requires -g and a positive number of columns" << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    if (sampleColumns > 0 && printMatrix) {
+        std::cout << "Sampling only estimates the count of -g, it cannot be combined with -v" << std::endl;
+        printUsage();
+        exit(1);
+    }
+
+    NetModel netModel;
+    try {
+        netModel = NetModel::fromSpec(netModelSpec);
+    } catch (const char* error) {
+        std::cout << "Unrecognized network model: " << netModelSpec << " (" << error << ")" << std::endl;
+        printUsage();
+        exit(1);
+    }
+
     return ProgramOptions(sparseMatrixFile, denseMatrixSeed, replicationGroupSize, multiplicationExponent,
                           useInnerAlgorithm ? Algorithm::InnerABC : Algorithm::ColumnA, printMatrix, printGreaterEqual,
-                          printGreaterEqualValue, printStats);
+                          printGreaterEqualValue, printStats, outOfCoreDir, numStripes, offload,
+                          transport, pin, reportFile, heartbeatInterval, heartbeatFile, netModel,
+                          profileFile, repeat, sampleColumns, tileOrder, denseFallback);
 }
 
 std::ostream &operator<<(std::ostream &os, ProgramOptions po) {
@@ -127,5 +240,19 @@ std::ostream &operator<<(std::ostream &os, ProgramOptions po) {
     os << "printMatrix: " << std::string(po.printMatrix ? "True" : "False") << std::endl;
     os << "printGreaterEqual: " << std::string(po.printGreaterEqual ? "True" : "False") << std::endl;
     os << "printGreaterEqualValue: " << po.printGreaterEqualValue << std::endl;
+    os << "outOfCoreDir: " << po.outOfCoreDir << std::endl;
+    os << "numStripes: " << po.numStripes << std::endl;
+    os << "offload: " << std::string(po.offload ? "True" : "False") << std::endl;
+    os << "transport: " << po.transport << std::endl;
+    os << "pin: " << std::string(po.pin ? "True" : "False") << std::endl;
+    os << "reportFile: " << po.reportFile << std::endl;
+    os << "heartbeatInterval: " << po.heartbeatInterval << std::endl;
+    os << "heartbeatFile: " << po.heartbeatFile << std::endl;
+    os << "netModel: " << po.netModel.describe() << std::endl;
+    os << "profileFile: " << po.profileFile << std::endl;
+    os << "repeat: " << po.repeat << std::endl;
+    os << "sampleColumns: " << po.sampleColumns << std::endl;
+    os << "tileOrder: " << po.tileOrder << std::endl;
+    os << "denseFallback: " << po.denseFallback << std::endl;
     return os;
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <string>
 
 #include "common.h"
+#include "net_model.h"
 
 class ProgramOptions {
 public:
@@ -17,6 +18,20 @@ public:
     bool printGreaterEqual;
     double printGreaterEqualValue;
     bool printStats;
+    std::string outOfCoreDir;  // node-local scratch for sparse matrix fragments, empty if disabled
+    int numStripes;            // number of concurrent stripes large sparse matrix transfers are split into
+    bool offload;              // run kernels on a compute thread, leaving the main thread to drive MPI
+    Transport transport;       // transport of sparse matrix fragments through the ring
+    bool pin;                  // pin processes and their threads according to the node topology
+    std::string reportFile;    // file the JSON run report is written to, empty if disabled
+    double heartbeatInterval;  // seconds between progress reports during multiplication, 0 if disabled
+    std::string heartbeatFile; // file progress reports are written to, stderr if empty
+    NetModel netModel;         // latency and bandwidth MPI transfers of the multiplication are slowed down to
+    std::string profileFile;   // file samples of the phase profiler are written to, empty if disabled
+    int repeat;                // number of times the multiplication is run on the distributed matrices
+    int sampleColumns;         // about that many columns of the result are sampled to estimate -g, 0 if exact
+    TileOrder tileOrder;       // order of tiles of fragments multiplied in tiled form, None if not tiled
+    DenseFallback denseFallback;  // whether A^e is computed densely by repeated squaring, Auto if planned
 
     static ProgramOptions fromCommandLine(int argc, char* argv[]);
 
@@ -25,7 +40,10 @@ public:
 private:
     ProgramOptions(std::string sparseMatrixFile, int denseMatrixSeed, int replicationGroupSize,
                    int multiplicationExponent, Algorithm algorithm, bool printMatrix, bool printGreaterEqual,
-                   double printGreaterEqualValue, bool printStats)
+                   double printGreaterEqualValue, bool printStats, std::string outOfCoreDir, int numStripes,
+                   bool offload, Transport transport, bool pin, std::string reportFile, double heartbeatInterval,
+                   std::string heartbeatFile, NetModel netModel, std::string profileFile,
+                   int repeat, int sampleColumns, TileOrder tileOrder, DenseFallback denseFallback)
         : sparseMatrixFile(sparseMatrixFile),
           denseMatrixSeed(denseMatrixSeed),
           replicationGroupSize(replicationGroupSize),
@@ -34,7 +52,21 @@ private:
           printMatrix(printMatrix),
           printGreaterEqual(printGreaterEqual),
           printGreaterEqualValue(printGreaterEqualValue),
-          printStats(printStats) {}
+          printStats(printStats),
+          outOfCoreDir(outOfCoreDir),
+          numStripes(numStripes),
+          offload(offload),
+          transport(transport),
+          pin(pin),
+          reportFile(reportFile),
+          heartbeatInterval(heartbeatInterval),
+          heartbeatFile(heartbeatFile),
+          netModel(netModel),
+          profileFile(profileFile),
+          repeat(repeat),
+          sampleColumns(sampleColumns),
+          tileOrder(tileOrder),
+          denseFallback(denseFallback) {}
 };
 
 #endif /* __PROGRAM_OPTIONS_H__ */
\ No newline at end of file
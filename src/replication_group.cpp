@@ -188,12 +188,80 @@ void safeMPI_Comm_free(MPI_Comm* comm) {
     }
 }
 
+/*
+    Duplication of inter communicator is collective over both of its groups, thus communicators are
+    duplicated in the same order as they were created, to avoid deadlock.
+*/
+void SparseMatrixReplicationGroup::createStripeComms(int numStripes) {
+    this->predStripeComms.assign(numStripes, this->predInterComm);
+    this->succStripeComms.assign(numStripes, this->succInterComm);
+    if (this->succInterComm == MPI_COMM_SELF) {
+        return;  // single replication group, there are no transfers
+    }
+
+    bool hasPredInterComm = this->predInterComm != MPI_COMM_NULL;
+    for (int s = 1; s < numStripes; s++) {
+        if (this->id % 2 == 0) {
+            MPI_Comm_dup(this->succInterComm, &this->succStripeComms[s]);
+            if (hasPredInterComm) {
+                MPI_Comm_dup(this->predInterComm, &this->predStripeComms[s]);
+            }
+        } else {
+            if (hasPredInterComm) {
+                MPI_Comm_dup(this->predInterComm, &this->predStripeComms[s]);
+            }
+            MPI_Comm_dup(this->succInterComm, &this->succStripeComms[s]);
+        }
+    }
+}
+
+/*
+    Each process knows only the leader of its successor, thus the leaders learn members of their predecessor
+    by gathering successor leaders of all processes. Since the topology is created over MPI_COMM_WORLD,
+    the MPI library is free to reorder ranks to match the physical topology; only neighborhood collectives
+    are used on the communicators, so the new ranks are never needed.
+*/
+void SparseMatrixReplicationGroup::createRingComms(int numStripes) {
+    if (this->succInterComm == MPI_COMM_SELF) {
+        return;  // single replication group, there are no transfers
+    }
+
+    int processId, numProcesses;
+    MPI_Comm_rank(MPI_COMM_WORLD, &processId);
+    MPI_Comm_size(MPI_COMM_WORLD, &numProcesses);
+
+    int source = this->succInterLeader;
+    std::vector<int> succLeaders(numProcesses);
+    MPI_Allgather(&source, 1, MPI_INT, succLeaders.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+    std::vector<int> destinations;
+    for (int p = 0; p < numProcesses; p++) {
+        if (succLeaders[p] == processId) {
+            destinations.push_back(p);
+        }
+    }
+
+    this->ringComms.assign(numStripes, MPI_COMM_NULL);
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, 1, &source, MPI_UNWEIGHTED, destinations.size(),
+                                   destinations.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 1, &this->ringComms[0]);
+    for (int s = 1; s < numStripes; s++) {
+        MPI_Comm_dup(this->ringComms[0], &this->ringComms[s]);
+    }
+}
+
 void DenseMatrixReplicationGroup::freeComms() {
     safeMPI_Comm_free(&this->internalComm);
     safeMPI_Comm_free(&this->leadersComm);
 }
 
 void SparseMatrixReplicationGroup::freeComms() {
+    for (int s = 1; s < (int)this->predStripeComms.size(); s++) {
+        safeMPI_Comm_free(&this->predStripeComms[s]);
+        safeMPI_Comm_free(&this->succStripeComms[s]);
+    }
+    for (MPI_Comm& comm : this->ringComms) {
+        safeMPI_Comm_free(&comm);
+    }
     safeMPI_Comm_free(&this->internalComm);
     safeMPI_Comm_free(&this->predInterComm);
     safeMPI_Comm_free(&this->succInterComm);
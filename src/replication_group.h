@@ -5,6 +5,7 @@
 
 #include <cassert>
 #include <string>
+#include <vector>
 
 #include "common.h"
 
@@ -57,8 +58,24 @@ public:
     MPI_Comm succInterComm = MPI_COMM_NULL;  // inter communicator for next replication group
     const int succInterLeader;
 
+    // Duplicates of inter communicators, stripe s of a transfer uses communicators at index s,
+    // index 0 holds the original inter communicators themselves
+    std::vector<MPI_Comm> predStripeComms;
+    std::vector<MPI_Comm> succStripeComms;
+
     void freeComms();
 
+    /* Duplicates inter communicators, so that transfers can be split into @numStripes concurrent stripes. */
+    void createStripeComms(int numStripes);
+
+    // Distributed graph topology of the ring: the only source of a process is the leader of the successor
+    // replication group, destinations of a leader are members of the predecessor replication group.
+    // Stripe s of a transfer uses communicator at index s, empty if there is a single replication group.
+    std::vector<MPI_Comm> ringComms;
+
+    /* Creates ring topology communicators (with reordering allowed) for @numStripes concurrent stripes. */
+    void createRingComms(int numStripes);
+
     static SparseMatrixReplicationGroup ofProcess(int processId, int numProcesses, int numReplicationGroups,
                                                   int replicationGroupSize, Algorithm algorithm);
 
@@ -0,0 +1,78 @@
+#ifndef __SPSC_QUEUE_H__
+#define __SPSC_QUEUE_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/*
+    Bounded queue for a single producer thread and a single consumer thread, lock-free unless the consumer
+    sleeps in waitPop(). Producer owns @tail, consumer owns @head, each of them only reads the other one.
+*/
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(int capacity) : slots(capacity + 1) {}
+
+    SpscQueue(const SpscQueue& other) = delete;
+    SpscQueue& operator=(const SpscQueue& other) = delete;
+
+    /* Returns false if queue is full. Called by the producer only. */
+    bool push(const T& value) {
+        int tail = this->tail.load(std::memory_order_relaxed);
+        int nextTail = (tail + 1) % this->slots.size();
+        if (nextTail == this->head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        this->slots[tail] = value;
+        this->tail.store(nextTail, std::memory_order_release);
+
+        // pairs with the fence of waitPop(), either the consumer sees the value or it is seen sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->consumerSleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->pushed.notify_one();
+        }
+        return true;
+    }
+
+    /* Returns false if queue is empty. Called by the consumer only. */
+    bool pop(T& value) {
+        int head = this->head.load(std::memory_order_relaxed);
+        if (head == this->tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = this->slots[head];
+        this->head.store((head + 1) % this->slots.size(), std::memory_order_release);
+        return true;
+    }
+
+    /* Pops value, sleeping while queue is empty. Called by the consumer only. */
+    void waitPop(T& value) {
+        if (this->pop(value)) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->consumerSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        this->pushed.wait(lock, [&]() { return this->pop(value); });
+        this->consumerSleeping.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    static const int CACHE_LINE_SIZE = 64;
+
+    // indices are kept on separate cache lines, so the threads do not invalidate each other's line on every update
+    std::vector<T> slots;
+    std::atomic<int> head{0};
+    char headPadding[CACHE_LINE_SIZE];
+    std::atomic<int> tail{0};
+    char tailPadding[CACHE_LINE_SIZE];
+
+    std::atomic<bool> consumerSleeping{false};
+    std::mutex mutex;
+    std::condition_variable pushed;
+};
+
+#endif /* __SPSC_QUEUE_H__ */
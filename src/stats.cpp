@@ -0,0 +1,239 @@
+#include <mpi.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "common.h"
+#include "context.h"
+#include "dense_power.h"
+#include "program_options.h"
+#include "stats.h"
+#include "utils.h"
+
+const int NUM_PHASES = (int)stats::Phase::Count;
+const int NUM_COUNTERS = (int)stats::Counter::Count;
+
+std::atomic<long long> phaseNanoseconds[NUM_PHASES];
+std::atomic<long long> counters[NUM_COUNTERS];
+std::atomic<long long> fragmentNonZeros{0};
+
+const char* stats::phaseName(Phase phase) {
+    static const char* names[NUM_PHASES] = {"parse",  "partition", "scatter", "generate", "kernel", "pack",
+                                            "unpack", "wait",      "reduce",  "gather",   "print"};
+    return names[(int)phase];
+}
+
+void stats::addPhaseTime(Phase phase, double seconds) {
+    phaseNanoseconds[(int)phase] += (long long)(seconds * 1e9);
+}
+
+void stats::add(Counter counter, long long value) { counters[(int)counter] += value; }
+
+void stats::setFragmentNonZeros(long long nonZeros) { fragmentNonZeros = nonZeros; }
+
+// Phases active on the thread, read by signal handlers interrupting the thread, thus entries are written
+// before they become visible through the depth
+thread_local volatile int phaseDepth = 0;
+thread_local volatile int phaseStack[stats::MAX_PHASE_DEPTH];
+
+int stats::currentPhasePath() {
+    int path = 0;
+    for (int i = 0; i < phaseDepth && i < MAX_PHASE_DEPTH; i++) {
+        path = path * (NUM_PHASES + 1) + phaseStack[i] + 1;
+    }
+    return path;
+}
+
+std::string stats::phasePathName(int path) {
+    std::string name;
+    for (; path > 0; path /= NUM_PHASES + 1) {
+        std::string phase = phaseName((Phase)(path % (NUM_PHASES + 1) - 1));
+        name = name.empty() ? phase : phase + ";" + name;
+    }
+    return name;
+}
+
+stats::PhaseScope::PhaseScope(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {
+    if (phaseDepth < MAX_PHASE_DEPTH) {
+        phaseStack[phaseDepth] = (int)phase;
+    }
+    std::atomic_signal_fence(std::memory_order_release);
+    phaseDepth = phaseDepth + 1;
+}
+
+stats::PhaseScope::~PhaseScope() {
+    phaseDepth = phaseDepth - 1;
+    std::atomic_signal_fence(std::memory_order_release);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - this->start;
+    addPhaseTime(this->phase, elapsed.count());
+}
+
+double stats::percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    int rank = (int)std::ceil(fraction * values.size());
+    return values[std::max(rank, 1) - 1];
+}
+
+std::string jsonString(const std::string& value) {
+    std::stringstream ss;
+    ss << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            ss << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+        } else {
+            ss << c;
+        }
+    }
+    ss << '"';
+    return ss.str();
+}
+
+std::string jsonBool(bool value) { return value ? "true" : "false"; }
+
+long long peakMemoryBytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (long long)usage.ru_maxrss * 1024;  // in kilobytes on Linux
+}
+
+/*
+    Per-process values are reduced with min, max and sum, the main leader writes the document, so it is
+    the only one, which needs the results.
+*/
+void stats::writeReport(Context& ctx, const ProgramOptions& options, const WallTimes& wallTimes,
+                        const DensePlan& plan, const std::string& fileName) {
+    std::vector<double> phases(NUM_PHASES);
+    for (int i = 0; i < NUM_PHASES; i++) {
+        phases[i] = phaseNanoseconds[i] / 1e9;
+    }
+    std::vector<double> phasesMin(NUM_PHASES), phasesMax(NUM_PHASES), phasesSum(NUM_PHASES);
+    MPI_Reduce(phases.data(), phasesMin.data(), NUM_PHASES, MPI_DOUBLE, MPI_MIN, MAIN_LEADER_ID, ctx.globalComm);
+    MPI_Reduce(phases.data(), phasesMax.data(), NUM_PHASES, MPI_DOUBLE, MPI_MAX, MAIN_LEADER_ID, ctx.globalComm);
+    MPI_Reduce(phases.data(), phasesSum.data(), NUM_PHASES, MPI_DOUBLE, MPI_SUM, MAIN_LEADER_ID, ctx.globalComm);
+
+    // process'es counters, followed by its peak memory, fragment size and fragment size counted once per group
+    bool isSparseRGLeader = ctx.process.sparseRG.isLeader(ctx.process.id);
+    std::vector<long long> values(NUM_COUNTERS);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        values[i] = counters[i];
+    }
+    values.push_back(peakMemoryBytes());
+    values.push_back(fragmentNonZeros);
+    values.push_back(isSparseRGLeader ? fragmentNonZeros.load() : 0);
+    int numValues = values.size();
+    std::vector<long long> valuesMin(numValues), valuesMax(numValues), valuesSum(numValues);
+    MPI_Reduce(values.data(), valuesMin.data(), numValues, MPI_LONG_LONG, MPI_MIN, MAIN_LEADER_ID, ctx.globalComm);
+    MPI_Reduce(values.data(), valuesMax.data(), numValues, MPI_LONG_LONG, MPI_MAX, MAIN_LEADER_ID, ctx.globalComm);
+    MPI_Reduce(values.data(), valuesSum.data(), numValues, MPI_LONG_LONG, MPI_SUM, MAIN_LEADER_ID, ctx.globalComm);
+
+    if (!ctx.process.isMainLeader()) {
+        return;
+    }
+
+    int peakMemoryIdx = NUM_COUNTERS, fragmentIdx = NUM_COUNTERS + 1, nonZerosIdx = NUM_COUNTERS + 2;
+    int p = ctx.numProcesses;
+    auto spread = [p](double min, double sum, double max) {
+        std::stringstream ss;
+        ss << std::fixed << "{\"min\": " << min << ", \"avg\": " << sum / p << ", \"max\": " << max << "}";
+        return ss.str();
+    };
+    auto counterTotals = [&](Counter counter) {
+        std::stringstream ss;
+        ss << "{\"total\": " << valuesSum[(int)counter] << ", \"max\": " << valuesMax[(int)counter] << "}";
+        return ss.str();
+    };
+
+    std::ofstream report(fileName);
+    if (!report) {
+        utils::abortWithError("Cannot open report file " + fileName);
+    }
+    report << std::fixed << std::setprecision(6);
+    report << "{" << std::endl;
+    report << "  \"config\": {" << std::endl;
+    report << "    \"sparseMatrixFile\": " << jsonString(options.sparseMatrixFile) << "," << std::endl;
+    report << "    \"denseMatrixSeed\": " << options.denseMatrixSeed << "," << std::endl;
+    report << "    \"numProcesses\": " << ctx.numProcesses << "," << std::endl;
+    report << "    \"replicationGroupSize\": " << options.replicationGroupSize << "," << std::endl;
+    report << "    \"multiplicationExponent\": " << options.multiplicationExponent << "," << std::endl;
+    report << "    \"algorithm\": \"" << (ctx.algorithm == Algorithm::ColumnA ? "ColumnA" : "InnerABC") << "\","
+           << std::endl;
+    report << "    \"outOfCoreDir\": " << jsonString(options.outOfCoreDir) << "," << std::endl;
+    report << "    \"numStripes\": " << options.numStripes << "," << std::endl;
+    report << "    \"offload\": " << jsonBool(options.offload) << "," << std::endl;
+    report << "    \"transport\": \"" << options.transport << "\"," << std::endl;
+    report << "    \"pin\": " << jsonBool(options.pin) << "," << std::endl;
+    report << "    \"netModel\": " << jsonString(options.netModel.describe()) << "," << std::endl;
+    report << "    \"heartbeatInterval\": " << options.heartbeatInterval << "," << std::endl;
+    report << "    \"heartbeatFile\": " << jsonString(options.heartbeatFile) << "," << std::endl;
+    report << "    \"profileFile\": " << jsonString(options.profileFile) << "," << std::endl;
+    report << "    \"repeat\": " << options.repeat << "," << std::endl;
+    report << "    \"sampleColumns\": " << options.sampleColumns << "," << std::endl;
+    report << "    \"tileOrder\": \"" << options.tileOrder << "\"," << std::endl;
+    report << "    \"denseFallback\": \"" << options.denseFallback << "\"" << std::endl;
+    report << "  }," << std::endl;
+
+    report << "  \"matrix\": {" << std::endl;
+    report << "    \"n\": " << ctx.matrixDimension << "," << std::endl;
+    report << "    \"nnz\": " << valuesSum[nonZerosIdx] << "," << std::endl;
+    report << "    \"fragmentNnz\": "
+           << spread(valuesMin[fragmentIdx], valuesSum[fragmentIdx], valuesMax[fragmentIdx]) << std::endl;
+    report << "  }," << std::endl;
+
+    report << "  \"wallTimes\": {" << std::endl;
+    report << "    \"execution\": " << wallTimes.execution << "," << std::endl;
+    report << "    \"init\": " << wallTimes.init << "," << std::endl;
+    report << "    \"multiplication\": " << wallTimes.multiplication << "," << std::endl;
+    report << "    \"gather\": " << wallTimes.gather << std::endl;
+    report << "  }," << std::endl;
+
+    const std::vector<double>& runs = wallTimes.multiplicationRuns;
+    report << "  \"multiplicationRuns\": {\"count\": " << runs.size() << ", \"min\": " << percentile(runs, 0.0)
+           << ", \"median\": " << percentile(runs, 0.5) << ", \"p95\": " << percentile(runs, 0.95) << "},"
+           << std::endl;
+
+    report << "  \"phases\": {" << std::endl;
+    for (int i = 0; i < NUM_PHASES; i++) {
+        report << "    \"" << phaseName((Phase)i) << "\": " << spread(phasesMin[i], phasesSum[i], phasesMax[i])
+               << (i + 1 < NUM_PHASES ? "," : "") << std::endl;
+    }
+    report << "  }," << std::endl;
+
+    report << "  \"bytes\": {" << std::endl;
+    report << "    \"ring\": " << counterTotals(Counter::RingBytes) << "," << std::endl;
+    report << "    \"dense\": " << counterTotals(Counter::DenseBytes) << "," << std::endl;
+    report << "    \"world\": " << counterTotals(Counter::WorldBytes) << std::endl;
+    report << "  }," << std::endl;
+
+    report << "  \"peakMemoryBytes\": {\"total\": " << valuesSum[peakMemoryIdx]
+           << ", \"max\": " << valuesMax[peakMemoryIdx] << "}," << std::endl;
+
+    report << "  \"plan\": {\"useDense\": " << jsonBool(plan.useDense) << ", \"sparseCost\": " << plan.sparseCost
+           << ", \"denseCost\": " << plan.denseCost << "}," << std::endl;
+
+    report << "  \"kernels\": {" << std::endl;
+    report << "    \"densePanel\": " << valuesSum[(int)Counter::DensePanelKernels] << "," << std::endl;
+    report << "    \"sparsePanel\": " << valuesSum[(int)Counter::SparsePanelKernels] << "," << std::endl;
+    report << "    \"skippedPanel\": " << valuesSum[(int)Counter::SkippedPanelKernels] << "," << std::endl;
+    report << "    \"columnPanel\": " << valuesSum[(int)Counter::ColumnPanelKernels] << "," << std::endl;
+    report << "    \"tiledPanel\": " << valuesSum[(int)Counter::TiledPanelKernels] << "," << std::endl;
+    report << "    \"denseProduct\": " << valuesSum[(int)Counter::DenseProducts] << std::endl;
+    report << "  }," << std::endl;
+
+    report << "  \"transport\": {" << std::endl;
+    report << "    \"kind\": \"" << ctx.transport << "\"," << std::endl;
+    report << "    \"numStripes\": " << ctx.numStripes << "," << std::endl;
+    report << "    \"outOfCore\": " << jsonBool(!options.outOfCoreDir.empty()) << std::endl;
+    report << "  }" << std::endl;
+    report << "}" << std::endl;
+}
@@ -0,0 +1,93 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+class Context;
+class ProgramOptions;
+struct DensePlan;
+
+/*
+    Process-wide statistics of the run: busy time of pipeline phases, counters of communicated bytes and
+    of kernel variants. Phases run on helper threads as well (parser, compute thread), so they may overlap
+    and do not sum up to the execution time. Safe to update from any thread.
+*/
+namespace stats {
+
+enum class Phase { Parse, Partition, Scatter, Generate, Kernel, Pack, Unpack, Wait, Reduce, Gather, Print, Count };
+
+enum class Counter {
+    RingBytes,   // sparse matrix fragments transferred through the ring (sent and received)
+    DenseBytes,  // reductions within dense matrix replication groups
+    WorldBytes,  // initial distribution, global checks and gathering of the result
+    DensePanelKernels,
+    SparsePanelKernels,
+    SkippedPanelKernels,
+    ColumnPanelKernels,  // kernels of narrow fragments in CSC format
+    TiledPanelKernels,   // kernels of fragments in tiled format
+    DenseProducts,       // column blocks of dense products of the dense fallback
+    Count
+};
+
+const char* phaseName(Phase phase);
+
+void addPhaseTime(Phase phase, double seconds);
+
+void add(Counter counter, long long value);
+
+/* Number of nonzero values of process'es sparse matrix fragment. */
+void setFragmentNonZeros(long long nonZeros);
+
+/* Number of nested phases a path of phases keeps, the deeper ones are attributed to their outer phase. */
+const int MAX_PHASE_DEPTH = 3;
+
+/* Number of distinct paths of nested phases, including the empty one (of at most MAX_PHASE_DEPTH phases). */
+const int NUM_PHASE_PATHS = ((int)Phase::Count + 1) * ((int)Phase::Count + 1) * ((int)Phase::Count + 1);
+
+/* Path of phases active on the calling thread, async-signal-safe. */
+int currentPhasePath();
+
+/* Names of phases on @path, outermost first, separated by ';'. */
+std::string phasePathName(int path);
+
+/*
+    Measures time spent within the scope as time of @phase. The phase is active on the calling thread within
+    the scope, nested in the phases of enclosing scopes.
+*/
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase phase);
+    ~PhaseScope();
+
+    PhaseScope(const PhaseScope& other) = delete;
+    PhaseScope& operator=(const PhaseScope& other) = delete;
+
+private:
+    Phase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+/* Wall times of the main thread of the main leader, the same as printed with -p. */
+struct WallTimes {
+    double execution;
+    double init;
+    double multiplication;
+    double gather;
+    std::vector<double> multiplicationRuns;  // of each run with --repeat, the slowest process'es one
+};
+
+/* Value below which @fraction of @values are (nearest rank), 0 if there are none. */
+double percentile(std::vector<double> values, double fraction);
+
+/*
+    Aggregates statistics over all processes and writes them as a single JSON document to @fileName
+    by the main leader, along with the @plan the multiplication took. Collective over all processes.
+*/
+void writeReport(Context& ctx, const ProgramOptions& options, const WallTimes& wallTimes, const DensePlan& plan,
+                 const std::string& fileName);
+
+}  // namespace stats
+
+#endif /* __STATS_H__ */
@@ -0,0 +1,299 @@
+#include <mpi.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+#include "stats.h"
+#include "task_graph.h"
+
+const TaskGraph::TaskId TaskGraph::NO_TASK;
+
+TaskGraph::TaskId TaskGraph::add(Action action, const std::vector<TaskId>& dependencies) {
+    TaskId id = this->tasks.size();
+    this->tasks.emplace_back();
+    Task& task = this->tasks.back();
+    task.action = std::move(action);
+
+    for (TaskId dependency : dependencies) {
+        if (dependency != NO_TASK) {
+            assert(dependency < id);
+            this->tasks[dependency].dependents.push_back(id);
+            task.numPendingDependencies++;
+        }
+    }
+
+    if (task.numPendingDependencies == 0) {
+        this->ready.push(id);
+    }
+    return id;
+}
+
+TaskGraph::TaskId TaskGraph::addAsync(AsyncAction action, const std::vector<TaskId>& dependencies) {
+    TaskId id = this->add(nullptr, dependencies);
+    this->tasks[id].asyncAction = std::move(action);
+    return id;
+}
+
+TaskGraph::TaskId TaskGraph::addCompute(ComputeAction action, const std::vector<TaskId>& dependencies) {
+    TaskId id = this->add(nullptr, dependencies);
+    this->tasks[id].computeAction = std::move(action);
+    return id;
+}
+
+void TaskGraph::delayCompletion(NetRole role, long long bytes) {
+    if (this->netModel == nullptr || this->started == NO_TASK) {
+        return;
+    }
+
+    // data is sent once the link is done with the earlier data, and arrives after the latency
+    Clock::time_point& linkFree = this->linkFree[(int)role];
+    Clock::time_point sent = std::max(Clock::now(), linkFree);
+    linkFree = sent + std::chrono::duration_cast<Clock::duration>(
+                          std::chrono::duration<double>(this->netModel->transferTime(role, bytes)));
+    Clock::time_point arrival = linkFree + std::chrono::duration_cast<Clock::duration>(
+                                               std::chrono::duration<double>(this->netModel->latency(role)));
+
+    Task& task = this->tasks[this->started];
+    task.notBefore = std::max(task.notBefore, arrival);
+}
+
+void TaskGraph::run() {
+    std::thread computeThread;
+    if (this->offloadCompute) {
+        this->toCompute.reset(new SpscQueue<TaskId>(COMPUTE_QUEUE_CAPACITY));
+        this->computed.reset(new SpscQueue<TaskId>(COMPUTE_QUEUE_CAPACITY));
+        computeThread = std::thread(&TaskGraph::computeLoop, this);
+    }
+
+    while (this->numFinished < (int)this->tasks.size()) {
+        // Keep MPI progressing between tasks, so requests of tasks in flight complete as soon as possible
+        this->progress(false);
+
+        if (this->numFinished == (int)this->tasks.size()) {
+            break;  // the progress finished the last tasks
+        } else if (!this->ready.empty()) {
+            TaskId id = this->ready.top();
+            this->ready.pop();
+            this->start(id);
+        } else {
+            assert((!this->requests.empty() || !this->asyncInFlight.empty() || this->numComputeInFlight > 0 ||
+                    !this->delayed.empty()) &&
+                   "Cyclic dependencies between tasks");
+            this->progress(true);
+        }
+    }
+
+    if (this->offloadCompute) {
+        while (!this->toCompute->push(NO_TASK)) {
+            std::this_thread::yield();
+        }
+        computeThread.join();
+    }
+}
+
+void TaskGraph::computeLoop() {
+    if (this->onComputeThreadStart) {
+        this->onComputeThreadStart();
+    }
+
+    while (true) {
+        TaskId id;
+        this->toCompute->waitPop(id);
+        if (id == NO_TASK) {
+            return;
+        }
+
+        this->tasks[id].computeAction();
+        this->tasks[id].computeAction = nullptr;  // release resources captured by the action
+
+        // start() keeps at most queue capacity tasks in flight, thus there is always space for the report
+        bool reported = this->computed->push(id);
+        assert(reported);
+        (void)reported;
+    }
+}
+
+void TaskGraph::start(TaskId id) {
+    if (this->tasks[id].asyncAction) {
+        this->tasks[id].future = this->tasks[id].asyncAction();
+        this->tasks[id].asyncAction = nullptr;  // release resources captured by the action
+        this->asyncInFlight.push_back(id);
+        return;
+    }
+
+    if (this->tasks[id].computeAction) {
+        if (this->offloadCompute) {
+            // tasks in flight are bounded by the capacity, so neither queue overflows while the compute thread
+            // lags far behind, wait for it to catch up
+            while (this->numComputeInFlight == COMPUTE_QUEUE_CAPACITY) {
+                this->progress(false);
+            }
+            bool handedOver = this->toCompute->push(id);
+            assert(handedOver);
+            (void)handedOver;
+            this->numComputeInFlight++;
+        } else {
+            this->tasks[id].computeAction();
+            this->tasks[id].computeAction = nullptr;  // release resources captured by the action
+            this->finish(id);
+        }
+        return;
+    }
+
+    std::vector<MPI_Request> taskRequests;
+    this->started = id;
+    this->tasks[id].action(taskRequests);
+    this->tasks[id].action = nullptr;  // release resources captured by the action
+    this->started = NO_TASK;
+
+    for (MPI_Request request : taskRequests) {
+        if (request != MPI_REQUEST_NULL) {
+            this->requests.push_back(request);
+            this->requestOwners.push_back(id);
+            this->tasks[id].numPendingRequests++;
+        }
+    }
+
+    if (this->tasks[id].numPendingRequests == 0) {
+        this->finishOrDelay(id);
+    }
+}
+
+void TaskGraph::finish(TaskId id) {
+    this->numFinished++;
+    for (TaskId dependent : this->tasks[id].dependents) {
+        if (--this->tasks[dependent].numPendingDependencies == 0) {
+            this->ready.push(dependent);
+        }
+    }
+}
+
+int TaskGraph::finishOrDelay(TaskId id) {
+    if (this->tasks[id].notBefore > Clock::now()) {
+        this->delayed.push(DelayedTask(this->tasks[id].notBefore, id));
+        return 0;
+    }
+    this->finish(id);
+    return 1;
+}
+
+void TaskGraph::progress(bool blocking) {
+    if (blocking) {
+        stats::PhaseScope phase(stats::Phase::Wait);
+        this->progressBlocking();
+        return;
+    }
+    this->progressCompute();
+    this->progressAsync();
+    this->progressRequests(false);
+    this->progressDelayed();
+}
+
+void TaskGraph::progressBlocking() {
+    if (this->asyncInFlight.empty() && this->numComputeInFlight == 0 && this->delayed.empty()) {
+        this->progressRequests(true);
+        return;
+    }
+    if (this->requests.empty() && this->asyncInFlight.empty() && this->delayed.empty()) {
+        // only kernels are in flight and there is no MPI to progress meanwhile, sleep until one is reported
+        TaskId id;
+        this->computed->waitPop(id);
+        this->numComputeInFlight--;
+        this->finish(id);
+        return;
+    }
+
+    // MPI cannot wait for futures, the compute thread nor the modeled network, thus all of them are polled until
+    // any task is finished. Polling MPI meanwhile is what keeps transfers progressing while kernels run.
+    while (this->progressCompute() + this->progressAsync() + this->progressRequests(false) +
+               this->progressDelayed() ==
+           0) {
+        if (this->numComputeInFlight > 0) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(10));
+        }
+    }
+}
+
+int TaskGraph::progressCompute() {
+    int numFinished = 0;
+    TaskId id;
+    while (this->numComputeInFlight > 0 && this->computed->pop(id)) {
+        this->numComputeInFlight--;
+        this->finish(id);
+        numFinished++;
+    }
+    return numFinished;
+}
+
+int TaskGraph::progressDelayed() {
+    int numFinished = 0;
+    Clock::time_point now = Clock::now();
+    while (!this->delayed.empty() && this->delayed.top().first <= now) {
+        this->finish(this->delayed.top().second);
+        this->delayed.pop();
+        numFinished++;
+    }
+    return numFinished;
+}
+
+int TaskGraph::progressAsync() {
+    int numFinished = 0;
+    int kept = 0;
+    for (int i = 0; i < (int)this->asyncInFlight.size(); i++) {
+        TaskId id = this->asyncInFlight[i];
+        if (this->tasks[id].future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            this->tasks[id].future.get();  // rethrows exception of the asynchronous action
+            this->finish(id);
+            numFinished++;
+        } else {
+            this->asyncInFlight[kept++] = id;
+        }
+    }
+    this->asyncInFlight.resize(kept);
+    return numFinished;
+}
+
+int TaskGraph::progressRequests(bool blocking) {
+    if (this->requests.empty()) {
+        return 0;
+    }
+
+    int numCompleted;
+    std::vector<int> completed(this->requests.size());
+    if (blocking) {
+        MPI_Waitsome(this->requests.size(), this->requests.data(), &numCompleted, completed.data(),
+                     MPI_STATUSES_IGNORE);
+    } else {
+        MPI_Testsome(this->requests.size(), this->requests.data(), &numCompleted, completed.data(),
+                     MPI_STATUSES_IGNORE);
+    }
+
+    if (numCompleted == MPI_UNDEFINED || numCompleted == 0) {
+        return 0;
+    }
+
+    int numFinished = 0;
+    for (int i = 0; i < numCompleted; i++) {
+        TaskId owner = this->requestOwners[completed[i]];
+        if (--this->tasks[owner].numPendingRequests == 0) {
+            numFinished += this->finishOrDelay(owner);
+        }
+    }
+
+    // drop completed requests, MPI sets them to MPI_REQUEST_NULL
+    int kept = 0;
+    for (int i = 0; i < (int)this->requests.size(); i++) {
+        if (this->requests[i] != MPI_REQUEST_NULL) {
+            this->requests[kept] = this->requests[i];
+            this->requestOwners[kept] = this->requestOwners[i];
+            kept++;
+        }
+    }
+    this->requests.resize(kept);
+    this->requestOwners.resize(kept);
+    return numFinished;
+}
@@ -0,0 +1,133 @@
+#ifndef __TASK_GRAPH_H__
+#define __TASK_GRAPH_H__
+
+#include <mpi.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "net_model.h"
+#include "spsc_queue.h"
+
+/*
+    Dependency graph of tasks executed by the calling thread.
+    Task's action is run once all of its dependencies are finished. Action may start nonblocking MPI operations
+    and hand over their requests to the graph, in such case the task is finished once all of them complete.
+    Asynchronous tasks start work outside of MPI (e.g. on a thread pool) and are finished once its future is ready.
+    Ready tasks are always executed in order of their creation, so tasks posting collectives on the same
+    communicator have to be chained with dependencies to keep the posting order consistent across processes.
+
+    Compute tasks perform no MPI calls. When compute is offloaded, they are handed over to a dedicated compute
+    thread through a queue, which the idle thread sleeps on, and reported back through another one, so the calling
+    thread acts as a communication agent: it keeps MPI progressing while kernels run, and sleeps only when
+    kernels are all there is in flight.
+
+    With a network model, actions declare data their requests receive, and the task is finished no sooner
+    than the data would arrive over the modeled network, even if MPI completed the requests earlier.
+*/
+class TaskGraph {
+public:
+    typedef int TaskId;
+    typedef std::function<void(std::vector<MPI_Request>& requests)> Action;
+    typedef std::function<std::future<void>()> AsyncAction;
+    typedef std::function<void()> ComputeAction;
+
+    static const TaskId NO_TASK = -1;
+
+    /*
+        @onComputeThreadStart is called by the compute thread before taking any task, e.g. to pin itself.
+        Network model, if given, has to outlive the graph.
+    */
+    explicit TaskGraph(bool offloadCompute = false, std::function<void()> onComputeThreadStart = nullptr,
+                       const NetModel* netModel = nullptr)
+        : offloadCompute(offloadCompute), onComputeThreadStart(onComputeThreadStart), netModel(netModel) {}
+
+    TaskGraph(const TaskGraph& other) = delete;
+    TaskGraph& operator=(const TaskGraph& other) = delete;
+
+    /* Adds task depending on @dependencies, NO_TASK entries are ignored. */
+    TaskId add(Action action, const std::vector<TaskId>& dependencies = {});
+
+    /* Adds asynchronous task depending on @dependencies, NO_TASK entries are ignored. */
+    TaskId addAsync(AsyncAction action, const std::vector<TaskId>& dependencies = {});
+
+    /* Adds compute task depending on @dependencies, NO_TASK entries are ignored. */
+    TaskId addCompute(ComputeAction action, const std::vector<TaskId>& dependencies = {});
+
+    /*
+        Called by the action of the task being started: the task is finished no sooner than @bytes received by
+        its requests would arrive over the link of @role of the network model. No-op without the model.
+    */
+    void delayCompletion(NetRole role, long long bytes);
+
+    /* Executes all tasks, returns once every task is finished. */
+    void run();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Task {
+        Action action;
+        AsyncAction asyncAction;
+        ComputeAction computeAction;
+        std::future<void> future;
+        int numPendingDependencies = 0;
+        int numPendingRequests = 0;
+        std::vector<TaskId> dependents;
+        Clock::time_point notBefore;  // arrival of the received data over the modeled network
+    };
+    typedef std::pair<Clock::time_point, TaskId> DelayedTask;
+
+    std::vector<Task> tasks;
+    std::priority_queue<TaskId, std::vector<TaskId>, std::greater<TaskId>> ready;
+    std::vector<MPI_Request> requests;  // requests of tasks being in flight
+    std::vector<TaskId> requestOwners;  // task owning each of @requests
+    std::vector<TaskId> asyncInFlight;  // asynchronous tasks being in flight
+    int numFinished = 0;
+    TaskId started = NO_TASK;  // task whose action is being run
+
+    static const int COMPUTE_QUEUE_CAPACITY = 1024;
+
+    const bool offloadCompute;
+    std::function<void()> onComputeThreadStart;
+    std::unique_ptr<SpscQueue<TaskId>> toCompute;  // compute tasks handed over to the compute thread
+    std::unique_ptr<SpscQueue<TaskId>> computed;   // compute tasks finished by the compute thread
+    int numComputeInFlight = 0;
+
+    const NetModel* netModel;
+    Clock::time_point linkFree[(int)NetRole::Count];  // modeled links are busy with earlier data until then
+    std::priority_queue<DelayedTask, std::vector<DelayedTask>, std::greater<DelayedTask>> delayed;
+
+    /* Body of the compute thread, runs handed over compute tasks until NO_TASK is received. */
+    void computeLoop();
+
+    void start(TaskId id);
+    void finish(TaskId id);
+
+    /* Finishes task whose requests completed, unless its data is yet to arrive over the modeled network. */
+    int finishOrDelay(TaskId id);
+
+    /* Finishes tasks whose requests completed, if @blocking waits until at least one task is finished. */
+    void progress(bool blocking);
+
+    /* Waits until at least one task is finished. */
+    void progressBlocking();
+
+    /* Finishes tasks whose requests completed, returns number of finished tasks. */
+    int progressRequests(bool blocking);
+
+    /* Finishes asynchronous tasks whose futures are ready, returns number of finished tasks. */
+    int progressAsync();
+
+    /* Finishes compute tasks reported back by the compute thread, returns number of finished tasks. */
+    int progressCompute();
+
+    /* Finishes delayed tasks whose data arrived over the modeled network, returns number of finished tasks. */
+    int progressDelayed();
+};
+
+#endif /* __TASK_GRAPH_H__ */
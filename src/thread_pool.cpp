@@ -0,0 +1,50 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int numThreads, std::function<void(int)> onStart) {
+    for (int i = 0; i < numThreads; i++) {
+        this->workers.emplace_back(&ThreadPool::work, this, i, onStart);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->jobAvailable.notify_all();
+
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job) {
+    std::packaged_task<void()> task(std::move(job));
+    std::future<void> result = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push(std::move(task));
+    }
+    this->jobAvailable.notify_one();
+    return result;
+}
+
+void ThreadPool::work(int worker, std::function<void(int)> onStart) {
+    if (onStart) {
+        onStart(worker);
+    }
+
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->jobAvailable.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+            if (this->jobs.empty()) {
+                return;
+            }
+            task = std::move(this->jobs.front());
+            this->jobs.pop();
+        }
+        task();
+    }
+}
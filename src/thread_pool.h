@@ -0,0 +1,37 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed size pool of worker threads executing submitted jobs in order of submission.
+    Jobs must not perform MPI calls, as MPI is initialized with MPI_THREAD_FUNNELED.
+    Each worker calls @onStart with its index before taking any job, e.g. to pin itself.
+*/
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads, std::function<void(int)> onStart = nullptr);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    std::future<void> submit(std::function<void()> job);
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::packaged_task<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    bool stopping = false;
+
+    void work(int worker, std::function<void(int)> onStart);
+};
+
+#endif /* __THREAD_POOL_H__ */
@@ -1,22 +1,30 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
 #include "common.h"
 #include "context.h"
 #include "matrix.h"
+#include "stats.h"
 #include "utils.h"
 
-int utils::initializeMatrixDimension(int processId, SparseMatrix& matrix) {
+int utils::initializeMatrixDimension(int processId, MatrixDimension matrixDimension) {
     int dimension;
     if (isMainLeader(processId)) {
-        dimension = matrix.dimension.col;
+        dimension = matrixDimension.col;
     }
     MPI_Bcast(&dimension, 1, MPI_INT, MAIN_LEADER_ID, MPI_COMM_WORLD);
 
     return dimension;
 }
 
-SparseMatrix utils::initializeSparseMatrix(Context& ctx, SparseMatrix& wholeMatrix) {
+std::tuple<utils::SparseMatrixAssembly, DenseMatrix> utils::initializeMatrices(Context& ctx,
+                                                                               std::future<SparseMatrix>& parsedMatrix,
+                                                                               int denseMatrixSeed,
+                                                                               int numSampledColumns) {
     SparseMatrixReplicationGroup rg = ctx.process.sparseRG;
+    SparseMatrixAssembly assembly;
     int recvSize;                                          // size of data scattered to process
-    PackedData recvData;                                   // data scattered to process
     PackedData accSendData;                                // accumulated packed data used for scatter
     std::vector<int> sendSizes(ctx.numProcesses);          // size of each process'es data
     std::vector<int> sendDisplacements(ctx.numProcesses);  // displacement of each process'es data
@@ -24,6 +32,14 @@ SparseMatrix utils::initializeSparseMatrix(Context& ctx, SparseMatrix& wholeMatr
     if (ctx.process.isMainLeader()) {
         // Send to each process its fragment of the matrix
         // distribute sparse matrix
+        // parser rethrows errors of the input, e.g. of its decompression
+        SparseMatrix wholeMatrix;
+        try {
+            wholeMatrix = parsedMatrix.get();
+        } catch (const char* error) {
+            utils::abortWithError(std::string("Cannot parse sparse matrix: ") + error);
+        }
+        stats::PhaseScope phase(stats::Phase::Partition);
         for (int p = 0; p < ctx.numProcesses; p++) {
             MatrixFragment frag = utils::getProcessSparseFragment(ctx, p);
             auto matrixFragment = std::move(wholeMatrix.maskSubMatrix(frag));
@@ -35,49 +51,100 @@ SparseMatrix utils::initializeSparseMatrix(Context& ctx, SparseMatrix& wholeMatr
                                std::make_move_iterator(packedMatrixFragment.end()));
         }
     }
-    // send information of packed data size to receive by the process
-    MPI_Scatter(sendSizes.data(), 1, MPI_INT, &recvSize, 1, MPI_INT, MAIN_LEADER_ID, MPI_COMM_WORLD);
-    recvData.resize(recvSize);
+    MPI_Request scatterReq, sizesReq;
+    {
+        stats::PhaseScope phase(stats::Phase::Scatter);
+        // send information of packed data size to receive by the process
+        MPI_Scatter(sendSizes.data(), 1, MPI_INT, &recvSize, 1, MPI_INT, MAIN_LEADER_ID, MPI_COMM_WORLD);
+        assembly.scatteredData.resize(recvSize);
+
+        // distribute initial sparse matrix fragments across processes
+        MPI_Iscatterv(accSendData.data(), sendSizes.data(), sendDisplacements.data(), MPI_PACKED,
+                      assembly.scatteredData.data(), recvSize, MPI_PACKED, MAIN_LEADER_ID, MPI_COMM_WORLD,
+                      &scatterReq);
+
+        // gather information about size of data held by each replication group member
+        assembly.packedSizes.resize(rg.size);
+        MPI_Iallgather(&recvSize, 1, MPI_INT, assembly.packedSizes.data(), 1, MPI_INT, rg.internalComm, &sizesReq);
+    }
+
+    // dense matrix is generated while sparse fragments are in flight
+    DenseMatrix denseMatrix;
+    {
+        stats::PhaseScope phase(stats::Phase::Generate);
+        denseMatrix = utils::initializeDenseMatrix(ctx, denseMatrixSeed, numSampledColumns);
+    }
+
+    stats::PhaseScope scatterPhase(stats::Phase::Scatter);
+    MPI_Wait(&sizesReq, MPI_STATUS_IGNORE);
+    int rgAccRecvSize = 0;  // total size of packed data in replication group
+    assembly.packedDisplacements.resize(rg.size);
+    for (int i = 0; i < rg.size; i++) {
+        assembly.packedDisplacements[i] = rgAccRecvSize;
+        rgAccRecvSize += assembly.packedSizes[i];
+    }
+    assembly.gatheredData.resize(rgAccRecvSize);
+
+    // gather packed data within replication group in the background, the scattered part is usable right away
+    MPI_Wait(&scatterReq, MPI_STATUS_IGNORE);
+    MPI_Iallgatherv(assembly.scatteredData.data(), recvSize, MPI_PACKED, assembly.gatheredData.data(),
+                    assembly.packedSizes.data(), assembly.packedDisplacements.data(), MPI_PACKED, rg.internalComm,
+                    &assembly.gatherReq);
 
-    // distribute initial sparse matrix fragments across processes
-    MPI_Scatterv(accSendData.data(), sendSizes.data(), sendDisplacements.data(), MPI_PACKED, recvData.data(), recvSize,
-                 MPI_PACKED, MAIN_LEADER_ID, MPI_COMM_WORLD);
+    MPI_Comm_rank(rg.internalComm, &assembly.memberId);
+    assembly.comm = rg.internalComm;
+    assembly.pending = true;
+    stats::add(stats::Counter::WorldBytes, recvSize + rgAccRecvSize);
 
-    int rgAccRecvSize = 0;                            // total size of packed data in replication group
-    std::vector<int> rgPackedSizes(rg.size);          // size of each member's packed data
-    std::vector<int> rgPackedDisplacements(rg.size);  // displacement of each member's packed data
-    PackedData rgAccRecvData;                         // accumulated packed data of replication group
+    assembly.local = unpack<SparseMatrix>(assembly.scatteredData, rg.internalComm);
 
-    // gather information about size of data held by each replication group member
-    MPI_Allgather(&recvSize, 1, MPI_INT, rgPackedSizes.data(), 1, MPI_INT, rg.internalComm);
+    return std::make_tuple(std::move(assembly), std::move(denseMatrix));
+}
 
-    for (int i = 0; i < (int)rgPackedSizes.size(); i++) {
-        rgPackedDisplacements[i] = rgAccRecvSize;
-        rgAccRecvSize += rgPackedSizes[i];
+SparseMatrix utils::SparseMatrixAssembly::complete() {
+    assert(this->pending);
+    {
+        stats::PhaseScope phase(stats::Phase::Scatter);
+        MPI_Wait(&this->gatherReq, MPI_STATUS_IGNORE);
     }
-    rgAccRecvData.resize(rgAccRecvSize);
+    this->pending = false;
 
-    // gather packed data within replication group
-    MPI_Allgatherv(recvData.data(), recvData.size(), MPI_PACKED, rgAccRecvData.data(), rgPackedSizes.data(),
-                   rgPackedDisplacements.data(), MPI_PACKED, rg.internalComm);
+    stats::PhaseScope phase(stats::Phase::Unpack);
 
-    // unpack and reconstruct replication group's matrix fragment
-    SparseMatrix resultMatrix = std::move(SparseMatrix::blank({ctx.matrixDimension, ctx.matrixDimension}));
-    for (int i = 0; i < rg.size; i++) {
-        auto matFrag =
-            unpack<SparseMatrix>(rgAccRecvData.data() + rgPackedDisplacements[i], rgPackedSizes[i], rg.internalComm);
-        resultMatrix.join(std::move(matFrag));
+    // unpack and reconstruct parts of replication group's matrix fragment held by other members
+    SparseMatrix resultMatrix = std::move(SparseMatrix::blank(this->local.dimension));
+    for (int i = 0; i < (int)this->packedSizes.size(); i++) {
+        if (i != this->memberId) {
+            auto matFrag = unpack<SparseMatrix>(this->gatheredData.data() + this->packedDisplacements[i],
+                                                this->packedSizes[i], this->comm);
+            resultMatrix.join(std::move(matFrag));
+        }
     }
 
+    this->scatteredData = PackedData();
+    this->gatheredData = PackedData();
     return resultMatrix;
 }
 
+SparseMatrix utils::SparseMatrixAssembly::whole() {
+    SparseMatrix remainder = this->complete();
+    SparseMatrix result = std::move(this->local);
+    result.join(std::move(remainder));
+    return result;
+}
+
+MPI_Request utils::SparseMatrixAssembly::detachRequest() {
+    MPI_Request request = this->gatherReq;
+    this->gatherReq = MPI_REQUEST_NULL;
+    return request;
+}
+
 /*
     Performs a fair chunk split of size @size into @numParts parts.
     Split is made so that each difference between parts is as small as possible (max 1).
     Returns a beginning of part @partId.
 */
-int getFairPartBeginning(int partId, int size, int numParts) {
+int utils::getFairPartBeginning(int partId, int size, int numParts) {
     int basePartSize = size / numParts;
     int numBiggerParts = std::min(partId, size % numParts);
 
@@ -86,12 +153,14 @@ int getFairPartBeginning(int partId, int size, int numParts) {
 
 std::tuple<int, int> getRgMemberFragment(int rgId, int idWithinRg, int matrixDimension, int numReplicationGroups,
                                          int replicationGroupSize) {
-    int rgFragmentStart = getFairPartBeginning(rgId, matrixDimension, numReplicationGroups);
-    int rgFragmentEnd = getFairPartBeginning(rgId + 1, matrixDimension, numReplicationGroups);
+    int rgFragmentStart = utils::getFairPartBeginning(rgId, matrixDimension, numReplicationGroups);
+    int rgFragmentEnd = utils::getFairPartBeginning(rgId + 1, matrixDimension, numReplicationGroups);
     int rgFragmentSize = rgFragmentEnd - rgFragmentStart;
 
-    int fragmentStart = rgFragmentStart + getFairPartBeginning(idWithinRg, rgFragmentSize, replicationGroupSize);
-    int fragmentEnd = rgFragmentStart + getFairPartBeginning(idWithinRg + 1, rgFragmentSize, replicationGroupSize);
+    int fragmentStart =
+        rgFragmentStart + utils::getFairPartBeginning(idWithinRg, rgFragmentSize, replicationGroupSize);
+    int fragmentEnd =
+        rgFragmentStart + utils::getFairPartBeginning(idWithinRg + 1, rgFragmentSize, replicationGroupSize);
 
     return {fragmentStart, fragmentEnd};
 }
@@ -181,43 +250,28 @@ MatrixFragment utils::getProcessDenseFragment(Context& ctx, int processId) {
     return {{0, processFragmentStart}, {ctx.matrixDimension, processFragmentEnd}};
 }
 
-DenseMatrix utils::initializeDenseMatrix(Context& ctx, int denseMatrixSeed) {
-    DenseMatrixReplicationGroup rg = ctx.process.denseRG;
-    auto frag = getProcessDenseFragment(ctx, ctx.process.id);
-    auto matrixFragment = DenseMatrix::generate(frag, denseMatrixSeed);
-    auto packedMatrixFragment = pack<DenseMatrix>(matrixFragment, rg.internalComm);
-
-    int rgAccRecvSize = 0;                            // total size of packed data in replication group
-    std::vector<int> rgPackedSizes(rg.size);          // size of each member's packed data
-    std::vector<int> rgPackedDisplacements(rg.size);  // displacement of each member's packed data
-    PackedData rgAccRecvData;                         // accumulated packed data of replication group
-
-    // gather information about size of data held by each replication group member
-    int packedSize = packedMatrixFragment.size();
-    MPI_Allgather(&packedSize, 1, MPI_INT, rgPackedSizes.data(), 1, MPI_INT, rg.internalComm);
-
-    for (int i = 0; i < (int)rgPackedSizes.size(); i++) {
-        rgPackedDisplacements[i] = rgAccRecvSize;
-        rgAccRecvSize += rgPackedSizes[i];
+/*
+    Dense matrix generator is stateless, thus instead of gathering fragments generated by each replication
+    group member, every member generates the whole fragment of its replication group by itself.
+*/
+DenseMatrix utils::initializeDenseMatrix(Context& ctx, int denseMatrixSeed, int numSampledColumns) {
+    if (numSampledColumns > 0) {
+        return DenseMatrix::generate(ctx.matrixDimension, getSampledColumns(ctx, denseMatrixSeed, numSampledColumns),
+                                     denseMatrixSeed);
     }
-    rgAccRecvData.resize(rgAccRecvSize);
 
-    // gather packed data within replication group
-    MPI_Allgatherv(packedMatrixFragment.data(), packedMatrixFragment.size(), MPI_PACKED, rgAccRecvData.data(),
-                   rgPackedSizes.data(), rgPackedDisplacements.data(), MPI_PACKED, rg.internalComm);
+    DenseMatrixReplicationGroup rg = ctx.process.denseRG;
+    int numReplicationGroups = ctx.algorithm == Algorithm::ColumnA ? ctx.numProcesses : ctx.numReplicationGroups;
 
-    // unpack and reconstruct replication group's matrix fragment
-    DenseMatrix resultMatrix = std::move(DenseMatrix::blank({ctx.matrixDimension, 0}));
-    for (int i = 0; i < rg.size; i++) {
-        auto matFrag =
-            unpack<DenseMatrix>(rgAccRecvData.data() + rgPackedDisplacements[i], rgPackedSizes[i], rg.internalComm);
-        resultMatrix.join(std::move(matFrag));
-    }
+    int rgFragmentStart = getFairPartBeginning(rg.id, ctx.matrixDimension, numReplicationGroups);
+    int rgFragmentEnd = getFairPartBeginning(rg.id + 1, ctx.matrixDimension, numReplicationGroups);
+    MatrixFragment frag = {{0, rgFragmentStart}, {ctx.matrixDimension, rgFragmentEnd}};
 
-    return resultMatrix;
+    return DenseMatrix::generate(frag, denseMatrixSeed);
 }
 
 DenseMatrix utils::gatherDenseMatrix(Context& ctx, DenseMatrix& matrix, int gatherTo) {
+    stats::PhaseScope phase(stats::Phase::Gather);
     DenseMatrixReplicationGroup rg = ctx.process.denseRG;
     DenseMatrix result = DenseMatrix::blank({matrix.dimension.row, matrix.dimension.row});
 
@@ -237,11 +291,103 @@ DenseMatrix utils::gatherDenseMatrix(Context& ctx, DenseMatrix& matrix, int gath
         }
         MPI_Gatherv(matrix.data.data(), matrix.data.size(), MPI_DOUBLE, result.data.data(), recvSizes.data(),
                     recvDisplacements.data(), MPI_DOUBLE, gatherTo, rg.leadersComm);
+        stats::add(stats::Counter::WorldBytes, matrix.data.size() * sizeof(double));
+    }
+    return result;
+}
+
+// Uniform value in [0, 1) determined by @seed and @column only (splitmix64 finalizer)
+double columnSampleValue(int seed, int column) {
+    uint64_t x = ((uint64_t)(uint32_t)seed << 32) ^ (uint32_t)column;
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return (x >> 11) * (1.0 / (1ULL << 53));
+}
+
+std::vector<int> utils::getSampledColumns(Context& ctx, int seed, int numSampledColumns) {
+    DenseMatrixReplicationGroup rg = ctx.process.denseRG;
+    int numReplicationGroups = ctx.algorithm == Algorithm::ColumnA ? ctx.numProcesses : ctx.numReplicationGroups;
+    int rgFragmentStart = getFairPartBeginning(rg.id, ctx.matrixDimension, numReplicationGroups);
+    int rgFragmentEnd = getFairPartBeginning(rg.id + 1, ctx.matrixDimension, numReplicationGroups);
+
+    double fraction = (double)numSampledColumns / ctx.matrixDimension;
+    std::vector<int> columns;
+    for (int c = rgFragmentStart; c < rgFragmentEnd; c++) {
+        if (columnSampleValue(seed, c) < fraction) {
+            columns.push_back(c);
+        }
+    }
+    return columns;
+}
+
+/*
+    Sampled columns are clusters of the simple random sample of columns: the count is estimated by the mean
+    count per sampled column, and its standard error by the sample variance of per column counts, corrected
+    for the finite number of columns. Each process takes the columns of its dense fragment.
+*/
+utils::CountEstimate utils::estimateCountGE(Context& ctx, DenseMatrix& matrix, double geValue, int seed,
+                                            int numSampledColumns, int gatherTo) {
+    stats::PhaseScope phase(stats::Phase::Gather);
+    MatrixIndex processFragmentStart, processFragmentEnd;
+    std::tie(processFragmentStart, processFragmentEnd) = utils::getProcessDenseFragment(ctx, ctx.process.id);
+
+    // number of sampled columns, sum of their counts and of squares of their counts
+    std::vector<int> columns = getSampledColumns(ctx, seed, numSampledColumns);
+    double sums[3] = {0.0, 0.0, 0.0};
+    for (int t = 0; t < (int)columns.size(); t++) {
+        if (processFragmentStart.col <= columns[t] && columns[t] < processFragmentEnd.col) {
+            double count = matrix.countGE({{0, t}, {matrix.dimension.row, t + 1}}, geValue);
+            sums[0] += 1;
+            sums[1] += count;
+            sums[2] += count * count;
+        }
+    }
+    double totals[3];
+    MPI_Reduce(sums, totals, 3, MPI_DOUBLE, MPI_SUM, gatherTo, ctx.globalComm);
+    stats::add(stats::Counter::WorldBytes, sizeof(sums));
+
+    double n = ctx.matrixDimension;
+    double m = totals[0];
+    CountEstimate result = {0.0, 0.0, n * n, (int)m};
+    if (ctx.process.id != gatherTo || m == 0) {
+        return result;
+    }
+
+    double mean = totals[1] / m;
+    result.estimate = n * mean;
+    if (m == n) {
+        // every column is sampled, so the count is exact
+        result.low = result.high = result.estimate;
+        return result;
+    }
+
+    // Wilson score interval of the fraction of sampled values counted, which stays wide when few or none
+    // of them are, while the counts of sampled columns may not vary at all
+    double z = 1.96;
+    double numValues = m * n;
+    double fraction = totals[1] / numValues;
+    double scale = 1 + z * z / numValues;
+    double center = (fraction + z * z / (2 * numValues)) / scale;
+    double halfWidth =
+        z / scale * std::sqrt(fraction * (1 - fraction) / numValues + z * z / (4 * numValues * numValues));
+    result.low = n * n * std::max(0.0, center - halfWidth);
+    result.high = n * n * std::min(1.0, center + halfWidth);
+
+    // normal interval of the mean count of a column (with finite population correction) widens it, when
+    // counted values cluster in some of the columns
+    if (m >= 2) {
+        double variance = std::max(0.0, (totals[2] - m * mean * mean) / (m - 1));
+        double standardError = n * std::sqrt(variance / m * (1 - m / n));
+        result.low = std::max(0.0, std::min(result.low, result.estimate - z * standardError));
+        result.high = std::min(n * n, std::max(result.high, result.estimate + z * standardError));
     }
     return result;
 }
 
 int utils::gatherCountGE(Context& ctx, DenseMatrix& matrix, double geValue, int gatherTo) {
+    stats::PhaseScope phase(stats::Phase::Gather);
     int numReplicationGroups = ctx.algorithm == Algorithm::ColumnA ? ctx.numProcesses : ctx.numReplicationGroups;
     DenseMatrixReplicationGroup rg = ctx.process.denseRG;
 
@@ -264,6 +410,11 @@ int utils::gatherCountGE(Context& ctx, DenseMatrix& matrix, double geValue, int
     return geCountRet;
 }
 
+void utils::abortWithError(const std::string& message) {
+    std::cerr << "error: " << message << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
 void utils::verifyPreconditions(int p, int c, Algorithm algorithm) {
     switch (algorithm) {
         case Algorithm::ColumnA:
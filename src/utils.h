@@ -3,6 +3,7 @@
 
 #include <mpi.h>
 
+#include <future>
 #include <string>
 
 #include "common.h"
@@ -11,11 +12,85 @@
 
 namespace utils {
 
-int initializeMatrixDimension(int processId, SparseMatrix& matrix);
+/*
+    Replication group's sparse matrix fragment, which assembly may still be in progress.
+    Part scattered to the process is available right away, while parts of the other replication
+    group members are still being gathered in the background.
+*/
+class SparseMatrixAssembly {
+public:
+    SparseMatrix local;  // part of the fragment scattered to the process
 
-SparseMatrix initializeSparseMatrix(Context& ctx, SparseMatrix& matrix);
+    SparseMatrixAssembly() = default;
+    SparseMatrixAssembly(SparseMatrixAssembly&& other) = default;
+    SparseMatrixAssembly& operator=(SparseMatrixAssembly&& other) = default;
 
-DenseMatrix initializeDenseMatrix(Context& ctx, int denseMatrixSeed);
+    bool isPending() const { return pending; }
+
+    /* Waits for the replication group gather and returns parts of the other members joined together. */
+    SparseMatrix complete();
+
+    /* Waits for the replication group gather and returns the whole fragment, including the local part. */
+    SparseMatrix whole();
+
+    /*
+        Hands over request of the replication group gather to the caller, who becomes responsible
+        for its completion before complete() is called.
+    */
+    MPI_Request detachRequest();
+
+    friend std::tuple<SparseMatrixAssembly, DenseMatrix> initializeMatrices(Context& ctx,
+                                                                            std::future<SparseMatrix>& parsedMatrix,
+                                                                            int denseMatrixSeed,
+                                                                            int numSampledColumns);
+
+private:
+    bool pending = false;                      // whether gather of the replication group is still in flight
+    int memberId = -1;                         // id of the process within replication group
+    MPI_Comm comm = MPI_COMM_NULL;             // replication group internal communicator
+    MPI_Request gatherReq = MPI_REQUEST_NULL;  // request of the replication group gather
+    PackedData scatteredData;                  // data scattered to process, source of the gather
+    PackedData gatheredData;                   // accumulated packed data of replication group
+    std::vector<int> packedSizes;              // size of each member's packed data
+    std::vector<int> packedDisplacements;      // displacement of each member's packed data
+};
+
+int initializeMatrixDimension(int processId, MatrixDimension dimension);
+
+int getFairPartBeginning(int partId, int size, int numParts);
+
+/*
+    Distributes sparse matrix parsed (possibly still being parsed) by the main leader and, while sparse
+    fragments are in flight, generates dense matrix fragment of the process (only its sampled columns,
+    if @numSampledColumns is nonzero).
+*/
+std::tuple<SparseMatrixAssembly, DenseMatrix> initializeMatrices(Context& ctx,
+                                                                 std::future<SparseMatrix>& parsedMatrix,
+                                                                 int denseMatrixSeed, int numSampledColumns = 0);
+
+DenseMatrix initializeDenseMatrix(Context& ctx, int denseMatrixSeed, int numSampledColumns = 0);
+
+/*
+    Columns of dense matrix fragment of process'es replication group, which are sampled, when about
+    @numSampledColumns columns of the whole matrix are. Each column is sampled independently, based on its
+    index and @seed only, so every process agrees on the sample and a larger sample contains the smaller one.
+*/
+std::vector<int> getSampledColumns(Context& ctx, int seed, int numSampledColumns);
+
+/* Estimate of a count with its 95% confidence interval. */
+struct CountEstimate {
+    double estimate;
+    double low;
+    double high;
+    int numSampledColumns;  // actual number of sampled columns of the whole matrix
+};
+
+/*
+    Estimates the number of values greater or equal to @geValue in the whole result from its sampled
+    columns (@matrix, see getSampledColumns), the estimate is valid in @gatherTo only.
+*/
+CountEstimate estimateCountGE(Context& ctx, DenseMatrix& matrix, double geValue, int seed, int numSampledColumns,
+                              int gatherTo);
 
 MatrixFragment getProcessDenseFragment(Context& ctx, int processId);
 
@@ -26,6 +101,9 @@ DenseMatrix gatherDenseMatrix(Context& ctx, DenseMatrix& matrix, int gatherTo);
 int gatherCountGE(Context& ctx, DenseMatrix& matrix, double geValue, int gatherTo);
 
 void verifyPreconditions(int p, int c, Algorithm algorithm);
+
+/* Prints @message to stderr and aborts all processes, for errors of a single process the others would wait on. */
+void abortWithError(const std::string& message);
 };  // namespace utils
 
 #endif /* __UTILS_H__ */
\ No newline at end of file